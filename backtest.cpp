@@ -0,0 +1,234 @@
+#include "time_series.hpp"
+#include "hedged_ptf.hpp"
+#include "vol_surface.hpp"
+#include "functions.hpp"
+#include "backtest.hpp"
+
+namespace project
+{
+	
+	namespace VS
+	{
+		
+		/* ------------------------------------- */
+		/* ---- ROLLING VOL SURFACE BACKTEST ---- */
+		/* ------------------------------------- */
+		
+		// constructors
+		surface_backtest::surface_backtest(const BS::hedged_ptf& ptf, std::vector<double> maturities, std::vector<double> strikes)
+			: m_strikes(strikes), m_maturities(maturities), m_block_size(32), p_ptf(&ptf)
+		{
+		}
+		
+		
+		
+		// destructor
+		surface_backtest::~surface_backtest()
+		{
+			PROJECT_LOG_DEBUG("Deletion of surface_backtest object " << get_name());
+		}
+		
+		
+		
+		
+		// access - data members
+		std::string surface_backtest::get_name() const
+		{
+			return p_ptf->get_name();
+		}
+		
+		const std::vector<double>& surface_backtest::get_strikes() const
+		{
+			return m_strikes;
+		}
+		
+		const std::vector<double>& surface_backtest::get_maturities() const
+		{
+			return m_maturities;
+		}
+		
+		std::size_t surface_backtest::get_block_size() const
+		{
+			return m_block_size;
+		}
+		
+		
+		
+		
+		// modify
+		void surface_backtest::let_block_size(std::size_t block_size)
+		{
+			if(block_size == 0)
+			{
+				PROJECT_LOG_ERROR("Error: block size of surface_backtest object " << get_name() << " must be positive");
+			}
+			else
+			{
+				m_block_size = block_size;
+			}
+		}
+		
+		
+		
+		
+		// computations
+		std::size_t surface_backtest::run(const std::string& path, std::size_t first, std::size_t last, bool robust_pnl,
+										  std::size_t step, std::size_t nb_threads) const
+		{
+			MT::thread_pool pool(nb_threads);
+			return run(pool, path, first, last, robust_pnl, step);
+		}
+		
+		std::size_t surface_backtest::run(MT::thread_pool& pool, const std::string& path, std::size_t first, std::size_t last,
+										  bool robust_pnl, std::size_t step) const
+		{
+			const TS::time_series& ts = p_ptf->get_ts();
+			last = std::min(last, ts.get_size());
+			if((first < 2) | (first > last) | (step == 0))
+			{
+				PROJECT_LOG_ERROR("Error on surface_backtest " << get_name() << ": as-of range " << first << " - " << last
+						<< " (step " << step << ") is not valid");
+				return 0;
+			}
+			
+			std::ofstream file(path);
+			if(!file.is_open())
+			{
+				PROJECT_LOG_ERROR("Error: backtest file " << path << " could not be created");
+				return 0;
+			}
+			
+			// header: one column per cell
+			std::size_t nstrikes = m_strikes.size(), nmaturities = m_maturities.size();
+			std::size_t ncells = nstrikes * nmaturities;
+			file << "Date";
+			for(std::size_t i = 0; i < nmaturities; ++i)
+				for(std::size_t j = 0; j < nstrikes; ++j)
+					file << ';' << m_maturities[i] << "M_" << m_strikes[j];
+			file << '\n';
+			
+			// maturities from the longest to the shortest (the longest cells are submitted first)
+			std::vector<std::size_t> order(nmaturities);
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b)
+			{
+				return m_maturities[a] > m_maturities[b];
+			});
+			
+			// as-of lines
+			std::vector<std::size_t> dates;
+			for(std::size_t line = first; line <= last; line += step)
+				dates.push_back(line);
+			
+			// two blocks: the one being computed and the one being written
+			// schedules of the ranges per as-of date and maturity of the block being computed, shared by the strikes
+			// (null: the range does not fit in the data)
+			const double nan = std::numeric_limits<double>::quiet_NaN();
+			std::vector<double> vols[2];
+			std::vector<std::shared_ptr<const BS::hedge_schedule>> schedules;
+			std::vector<double> guesses(ncells, nan); // vols of the last as-of date of the previous block
+			std::size_t written = 0;
+			
+			auto write_block = [&](std::size_t b, std::size_t begin, std::size_t end)
+			{
+				std::string buffer;
+				char date[csv::format_size];
+				for(std::size_t d = begin; d < end; ++d)
+				{
+					buffer.append(date, csv::format_date(date, ts.get_day(dates[d])));
+					const double* row = vols[b].data() + (d - begin) * ncells;
+					for(std::size_t c = 0; c < ncells; ++c)
+					{
+						buffer += ';';
+						if(row[c] == row[c])
+							csv::append_double(buffer, row[c]);
+					}
+					buffer += '\n';
+				}
+				file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+				written += end - begin;
+			};
+			
+			std::size_t previous_begin = 0, previous_end = 0, previous_b = 1;
+			for(std::size_t begin = 0, b = 0; begin < dates.size(); begin += m_block_size, b = 1 - b)
+			{
+				std::size_t end = std::min(begin + m_block_size, dates.size());
+				std::size_t size = end - begin;
+				
+				// invariants of the as-of dates: schedule of the range of each maturity
+				// (the tasks of the previous block are done: its schedules can be released)
+				schedules.assign(size * nmaturities, nullptr);
+				for(std::size_t d = 0; d < size; ++d)
+				{
+					TS::day_t first_day = ts.get_day(1);
+					for(std::size_t i = 0; i < nmaturities; ++i)
+					{
+						struct std::tm tm = ts.get_date(dates[begin + d]);
+						tm.tm_mon -= static_cast<int>(m_maturities[i]);
+						if(TS::to_days(tm) < first_day)
+							continue;
+						// no range with a single line, after a gap of more than the maturity in the data
+						std::size_t start = ts.shift_months(dates[begin + d], static_cast<int>(m_maturities[i]), false);
+						if(start >= dates[begin + d])
+							continue;
+						schedules[d * nmaturities + i] = std::make_shared<const BS::hedge_schedule>(*p_ptf, start, dates[begin + d]);
+					}
+				}
+				vols[b].assign(size * ncells, nan);
+				
+				// one task per cell: its as-of dates in order, warm-started from the previous one
+				for(std::size_t i : order)
+				{
+					for(std::size_t j = 0; j < nstrikes; ++j)
+					{
+						std::size_t cell = i * nstrikes + j;
+						const BS::hedged_ptf* ptf = p_ptf;
+						const std::size_t* block_dates = dates.data() + begin;
+						const std::shared_ptr<const BS::hedge_schedule>* block_schedules = schedules.data() + i;
+						double* block_vols = vols[b].data() + cell;
+						double* guess = &guesses[cell];
+						double pct = m_strikes[j];
+						pool.submit([ptf, block_schedules, block_vols, guess, pct, size, nmaturities, ncells, robust_pnl]()
+						{
+							for(std::size_t d = 0; d < size; ++d)
+							{
+								const BS::hedge_schedule* schedule = block_schedules[d * nmaturities].get();
+								if(!schedule)
+								{
+									*guess = std::numeric_limits<double>::quiet_NaN();
+									continue;
+								}
+								double strike = pct * schedule->get_spots()[0] / 100.0;
+								BS::solver_result result = (*guess > 0.0)
+									? ptf->solve_implied_vol_from(*schedule, strike, *guess, robust_pnl)
+									: ptf->solve_implied_vol(*schedule, strike, robust_pnl);
+								if(!result.converged)
+								{
+									PROJECT_LOG_WARNING("Solver for implied vol did not converge in " << result.iterations << " iterations");
+									result.vol = 0;
+								}
+								block_vols[d * ncells] = result.vol;
+								*guess = result.vol;
+							}
+						});
+					}
+				}
+				
+				// the previous block is written while this one is computed
+				if(previous_end > previous_begin)
+					write_block(previous_b, previous_begin, previous_end);
+				pool.wait();
+				previous_begin = begin;
+				previous_end = end;
+				previous_b = b;
+			}
+			if(previous_end > previous_begin)
+				write_block(previous_b, previous_begin, previous_end);
+			
+			PROJECT_LOG_INFO("surface_backtest " << get_name() << ": " << written << " surfaces exported to " << path);
+			return written;
+		}
+		
+	}
+
+}
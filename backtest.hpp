@@ -0,0 +1,92 @@
+#ifndef BACKTEST_HPP
+#define BACKTEST_HPP
+
+// libs of the project
+
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "thread_pool.hpp" // parallel computations
+
+namespace project
+{
+	
+	namespace VS
+	{
+		
+		/* ------------------------------------- */
+		/* ---- ROLLING VOL SURFACE BACKTEST ---- */
+		/* ------------------------------------- */
+		
+		// surfaces of a range of as-of dates: for each as-of line, the cells are computed on the ranges ending
+		// on this line (as vol_surface does with the last line). The as-of dates are computed by blocks:
+		// - each cell of a block is one task, solving its as-of dates in order, each one warm-started from the
+		//   previous one (the ranges of two consecutive dates overlap, so the vols are close)
+		// - the start of each range and its spot are computed once per as-of date and maturity, for all the strikes
+		// - a block is written to the csv file while the next one is computed: only two blocks are in memory
+		class surface_backtest
+		{
+		public:
+			
+			// constructors
+			surface_backtest(const BS::hedged_ptf& ptf,
+							 std::vector<double> maturities = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},
+							 std::vector<double> strikes = {50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150});
+			
+			// destructor
+			~surface_backtest();
+			
+			
+			// access - data members
+			std::string get_name() const; // from the pointed ptf
+			const std::vector<double>& get_strikes() const;
+			const std::vector<double>& get_maturities() const;
+			std::size_t get_block_size() const; // number of as-of dates per block
+			
+			
+			// modify
+			void let_block_size(std::size_t block_size);
+			
+			
+			// computes the surfaces of the as-of lines first, first + step, ... until last (base 1, as time_series)
+			// and writes them to a csv file: one line per as-of date, one column per cell (maturity, strike)
+			// the cells whose range would start before the first date are left empty
+			// returns the number of as-of dates written
+			std::size_t run(const std::string& path, std::size_t first, std::size_t last, bool robust_pnl = false,
+							std::size_t step = 1, std::size_t nb_threads = 0) const; // 0: one thread per core
+			std::size_t run(MT::thread_pool& pool, const std::string& path, std::size_t first, std::size_t last,
+							bool robust_pnl = false, std::size_t step = 1) const; // on an existing pool
+			
+			
+			
+			
+		private:
+			
+			// data members
+			std::vector<double> m_strikes; // in % of the spot at the start of the range
+			std::vector<double> m_maturities; // in months
+			std::size_t m_block_size;
+			
+			// hedged_ptf class from which we get the implied vols
+			const BS::hedged_ptf *p_ptf;
+			
+		};
+		
+	}
+
+}
+
+
+
+#endif
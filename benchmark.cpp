@@ -0,0 +1,410 @@
+#include "time_series.hpp"
+#include "hedged_ptf.hpp"
+#include "vol_surface.hpp"
+#include "functions.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <utility>
+
+#ifndef BENCHMARK_BUILD_TYPE
+#define BENCHMARK_BUILD_TYPE "unknown"
+#endif
+
+// Benchmarks of the project on synthetic data
+// usage: project_benchmark [--min-rows N] [--max-rows N] [--seed S] [--min-time SECONDS] [--dir PATH] [--out FILE]
+// the results are written as JSON (to --out, or to the standard output): one entry per benchmark and size,
+// with the time per operation, the number of rows (or items) per second, so that two builds can be compared
+// and the scaling with the size of the data read from the entries of a same benchmark
+
+namespace
+{
+	using namespace project;
+
+	/* ------------------------ */
+	/* ---- DATA GENERATOR ---- */
+	/* ------------------------ */
+
+	// geometric brownian motion with normal jumps (Merton), one line per business day from 01/01/1900
+	// the same seed gives the same series (with the same standard library)
+	void generate_series(std::size_t rows, std::uint64_t seed, std::vector<TS::day_t>& days, std::vector<double>& values)
+	{
+		const double mu = 0.05, sigma = 0.2, dt = 1.0 / 252.0; // drift and vol per year
+		const double jump_intensity = 0.5, jump_mean = -0.05, jump_vol = 0.1; // jumps per year and log-jump size
+
+		std::mt19937_64 engine(seed);
+		std::normal_distribution<double> normal(0.0, 1.0);
+		std::bernoulli_distribution jump(jump_intensity * dt);
+
+		days.resize(rows);
+		values.resize(rows);
+		TS::day_t day = TS::days_from_civil(1900, 1, 1);
+		double spot = 100.0;
+		for(std::size_t i = 0; i < rows; ++i)
+		{
+			// business days only (1970-01-01 is a thursday)
+			while(((day % 7 + 7 + 3) % 7) >= 5)
+				++day;
+			days[i] = day++;
+			values[i] = spot;
+
+			double log_return = (mu - 0.5 * sigma * sigma) * dt + sigma * std::sqrt(dt) * normal(engine);
+			if(jump(engine))
+				log_return += jump_mean + jump_vol * normal(engine);
+			spot *= std::exp(log_return);
+		}
+	}
+
+	// csv file in the format of data.csv (dd/mm/yyyy;value), false if the dates do not fit on 4 digits
+	bool write_csv(const std::string& path, const std::vector<TS::day_t>& days, const std::vector<double>& values)
+	{
+		if(!days.empty() && TS::civil_from_days(days.back()).year > 9999)
+			return false;
+
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if(!file)
+			return false;
+		for(std::size_t i = 0; i < days.size(); ++i)
+		{
+			TS::civil_date date = TS::civil_from_days(days[i]);
+			std::fprintf(file, "%02d/%02d/%04d;%.10g\n", date.day, date.month, date.year, values[i]);
+		}
+		std::fclose(file);
+		return true;
+	}
+
+
+
+	/* ------------------- */
+	/* ---- BENCHMARK ---- */
+	/* ------------------- */
+
+	struct result
+	{
+		std::string name;
+		std::size_t rows; // size of the data (0 for the microbenchmarks)
+		std::size_t ops; // number of operations timed
+		double ns_per_op;
+		double items_per_op; // rows (or options) processed by one operation
+	};
+
+	// keeps the results alive (so that the compiler does not remove the computations)
+	volatile double sink = 0.0;
+
+	// runs op (which returns a double) enough times to last at least min_time seconds
+	template<typename F>
+	result measure(const std::string& name, std::size_t rows, double items_per_op, double min_time, F op)
+	{
+		typedef std::chrono::steady_clock clock;
+		std::size_t count = 1;
+		while(true)
+		{
+			double acc = 0.0;
+			clock::time_point start = clock::now();
+			for(std::size_t i = 0; i < count; ++i)
+				acc += op(i);
+			double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+			sink = sink + acc;
+
+			if(elapsed >= min_time || count >= (std::size_t(1) << 40))
+				return result{name, rows, count, elapsed * 1e9 / static_cast<double>(count), items_per_op};
+
+			// next count from the current rate (at least doubled)
+			double target = (elapsed > 0.0) ? 1.2 * min_time / elapsed * static_cast<double>(count) : 2.0 * static_cast<double>(count);
+			count = std::max(2 * count, static_cast<std::size_t>(std::min(target, 1e12)));
+		}
+	}
+
+	void print_json(std::ostream& out, const std::vector<result>& results, std::uint64_t seed)
+	{
+		out << "{\n";
+		out << "  \"build\": {\"type\": \"" << BENCHMARK_BUILD_TYPE << "\", \"compiler\": \"" << __VERSION__
+			<< "\", \"date\": \"" << __DATE__ << ' ' << __TIME__ << "\", \"threads\": " << std::thread::hardware_concurrency() << "},\n";
+		out << "  \"seed\": " << seed << ",\n";
+		out << "  \"results\": [\n";
+		for(std::size_t i = 0; i < results.size(); ++i)
+		{
+			const result& r = results[i];
+			double items_per_s = r.items_per_op / (r.ns_per_op * 1e-9);
+			out << "    {\"name\": \"" << r.name << "\", \"rows\": " << r.rows << ", \"ops\": " << r.ops
+				<< ", \"ns_per_op\": " << r.ns_per_op << ", \"items_per_op\": " << r.items_per_op
+				<< ", \"items_per_s\": " << items_per_s << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		out << "  ]\n";
+		out << "}\n";
+	}
+
+
+
+	/* -------------------- */
+	/* ---- BENCHMARKS ---- */
+	/* -------------------- */
+
+	// Black-Scholes formulas and date parsing, on random inputs
+	void micro_benchmarks(std::vector<result>& results, std::uint64_t seed, double min_time)
+	{
+		const std::size_t n = 4096; // inputs cycled by the benchmarks
+		std::mt19937_64 engine(seed);
+		std::uniform_real_distribution<double> spot(50.0, 150.0), mat(0.01, 2.0), vol(0.05, 0.8), x(-6.0, 6.0);
+		std::vector<double> S(n), T(n), V(n), X(n), prices(n), deltas(n);
+		std::vector<std::string> dates(n);
+		for(std::size_t i = 0; i < n; ++i)
+		{
+			S[i] = spot(engine);
+			T[i] = mat(engine);
+			V[i] = vol(engine);
+			X[i] = x(engine);
+			TS::civil_date date = TS::civil_from_days(static_cast<TS::day_t>(engine() % 40000));
+			char buffer[16];
+			std::snprintf(buffer, sizeof(buffer), "%02d/%02d/%04d", date.day, date.month, date.year);
+			dates[i] = buffer;
+		}
+		const std::size_t mask = n - 1;
+
+		results.push_back(measure("normal_cdf", 0, 1.0, min_time, [&](std::size_t i)
+		{
+			return BS::normal_cdf(X[i & mask]);
+		}));
+		results.push_back(measure("price_bs", 0, 1.0, min_time, [&](std::size_t i)
+		{
+			return BS::price_bs(S[i & mask], 100.0, T[i & mask], 0.01, V[i & mask]);
+		}));
+		results.push_back(measure("delta_bs", 0, 1.0, min_time, [&](std::size_t i)
+		{
+			return BS::delta_bs(S[i & mask], 100.0, T[i & mask], 0.01, V[i & mask]);
+		}));
+		results.push_back(measure("batch_bs_price_delta", 0, static_cast<double>(n), min_time, [&](std::size_t)
+		{
+			BS::bs_outputs outputs;
+			outputs.price = prices.data();
+			outputs.delta = deltas.data();
+			BS::batch_bs(n, S.data(), 100.0, T.data(), 0.01, 0.2, outputs);
+			return prices[0] + deltas[n - 1];
+		}));
+		
+		// accuracy tiers of the normal distributions
+		const std::vector<std::pair<BS::accuracy, std::string>> tiers = {{BS::accuracy::high, "high"}, {BS::accuracy::fast, "fast"},
+		                                                                 {BS::accuracy::single, "single"}};
+		for(const auto& tier : tiers)
+		{
+			BS::accuracy acc = tier.first;
+			results.push_back(measure("normal_cdf_" + tier.second, 0, 1.0, min_time, [&](std::size_t i)
+			{
+				return BS::normal_cdf(X[i & mask], acc);
+			}));
+			results.push_back(measure("batch_bs_price_delta_" + tier.second, 0, static_cast<double>(n), min_time, [&](std::size_t)
+			{
+				BS::bs_outputs outputs;
+				outputs.price = prices.data();
+				outputs.delta = deltas.data();
+				BS::batch_bs(n, S.data(), 100.0, T.data(), 0.01, 0.2, outputs, true, acc);
+				return prices[0] + deltas[n - 1];
+			}));
+		}
+		results.push_back(measure("to_date", 0, 1.0, min_time, [&](std::size_t i)
+		{
+			return static_cast<double>(TS::to_date(dates[i & mask]).tm_mday);
+		}));
+		
+		// formatting of the exports: stream against csv::format_double
+		std::ostringstream stream;
+		results.push_back(measure("format_double_stream", 0, 1.0, min_time, [&](std::size_t i)
+		{
+			stream.str(std::string());
+			stream << V[i & mask];
+			return static_cast<double>(stream.tellp());
+		}));
+		char field[csv::format_size];
+		results.push_back(measure("format_double", 0, 1.0, min_time, [&](std::size_t i)
+		{
+			return static_cast<double>(csv::format_double(field, V[i & mask]) - field);
+		}));
+	}
+
+	// loading, indexing and pnl computations on a generated series of a given size
+	void data_benchmarks(std::vector<result>& results, std::size_t rows, std::uint64_t seed, double min_time,
+						 const std::string& dir)
+	{
+		std::vector<TS::day_t> days;
+		std::vector<double> values;
+		generate_series(rows, seed, days, values);
+		double nrows = static_cast<double>(rows);
+
+		std::string base = dir + "/benchmark_" + std::to_string(rows);
+		std::string csv_path = base + ".csv", snapshot_path = base + ".tss";
+
+		// loading (csv only while the years fit on 4 digits)
+		if(write_csv(csv_path, days, values))
+		{
+			results.push_back(measure("csv_load_mmap", rows, nrows, min_time, [&](std::size_t)
+			{
+				TS::time_series ts("benchmark", csv_path);
+				return static_cast<double>(ts.get_size());
+			}));
+			if(rows <= 100000) // the stream loader is too slow beyond
+			{
+				results.push_back(measure("csv_load_stream", rows, nrows, min_time, [&](std::size_t)
+				{
+					std::ifstream file(csv_path);
+					TS::time_series ts("benchmark", file);
+					return static_cast<double>(ts.get_size());
+				}));
+			}
+			std::remove(csv_path.c_str());
+		}
+
+		TS::time_series series("benchmark", 0);
+		for(std::size_t i = 0; i < rows; ++i)
+			series.append(days[i], values[i]);
+		series.save_snapshot(snapshot_path);
+		results.push_back(measure("snapshot_open", rows, nrows, min_time, [&](std::size_t)
+		{
+			TS::time_series ts("benchmark", snapshot_path);
+			return static_cast<double>(ts.get_size());
+		}));
+
+		// date lookups on random dates of the series
+		std::mt19937_64 engine(seed + rows);
+		std::vector<TS::day_t> lookups(1024);
+		for(std::size_t i = 0; i < lookups.size(); ++i)
+			lookups[i] = days[engine() % rows];
+		results.push_back(measure("get_index", rows, 1.0, min_time, [&](std::size_t i)
+		{
+			return static_cast<double>(series.get_index(lookups[i & 1023]));
+		}));
+
+		// pnl on the whole series, implied vol and vol surface
+		BS::hedged_ptf ptf("benchmark", snapshot_path);
+		double strike = values[0];
+		results.push_back(measure("get_pnl", rows, nrows, min_time, [&](std::size_t)
+		{
+			return ptf.get_pnl(1, rows, strike, 0.2);
+		}));
+		results.push_back(measure("get_robust_pnl", rows, nrows, min_time, [&](std::size_t)
+		{
+			return ptf.get_robust_pnl(1, rows, strike, 0.2);
+		}));
+		
+		// same on a schedule built once (as in the solvers)
+		BS::hedge_schedule schedule(ptf, 1, rows);
+		results.push_back(measure("get_pnl_schedule", rows, nrows, min_time, [&](std::size_t)
+		{
+			return ptf.get_pnl(schedule, strike, 0.2);
+		}));
+		results.push_back(measure("get_robust_pnl_schedule", rows, nrows, min_time, [&](std::size_t)
+		{
+			return ptf.get_robust_pnl(schedule, strike, 0.2);
+		}));
+		if(rows <= 1000000)
+		{
+			results.push_back(measure("get_implied_vol", rows, nrows, min_time, [&](std::size_t)
+			{
+				return ptf.get_implied_vol(1, rows, strike);
+			}));
+		}
+		if(rows >= 300) // at least 12 months
+		{
+			VS::vol_surface vs(ptf);
+			results.push_back(measure("load_vol_surface", rows, 132.0, min_time, [&](std::size_t)
+			{
+				vs.load_vol_surface();
+				return vs.get_vol(100, 12);
+			}));
+			
+			// off-grid queries of the computed surface
+			const std::size_t n = 4096;
+			std::vector<double> query_strikes(n), query_maturities(n), query_vols(n);
+			for(std::size_t i = 0; i < n; ++i)
+			{
+				query_strikes[i] = 40.0 + 120.0 * static_cast<double>(engine() % 10000) / 10000.0;
+				query_maturities[i] = 0.5 + 12.0 * static_cast<double>(engine() % 10000) / 10000.0;
+			}
+			const std::pair<VS::interpolation, std::string> methods[] = {{VS::interpolation::bilinear, "bilinear"},
+																		 {VS::interpolation::cubic, "cubic"}};
+			for(const auto& method : methods)
+			{
+				results.push_back(measure("get_vols_" + method.second, rows, static_cast<double>(n), min_time, [&](std::size_t)
+				{
+					vs.get_vols(query_strikes.data(), query_maturities.data(), n, query_vols.data(), method.first);
+					return query_vols[0];
+				}));
+			}
+		}
+		std::remove(snapshot_path.c_str());
+	}
+}
+
+
+
+int main(int argc, char* argv[])
+{
+	std::size_t min_rows = 1000, max_rows = 1000000;
+	std::uint64_t seed = 42;
+	double min_time = 0.2;
+	std::string dir = ".", out_path;
+
+	const char* usage = "usage: project_benchmark [--min-rows N] [--max-rows N] [--seed S] [--min-time SECONDS] [--dir PATH] [--out FILE]";
+	for(int i = 1; i < argc; i += 2)
+	{
+		std::string option(argv[i]);
+		if(i + 1 == argc)
+		{
+			std::cerr << "Missing value of option " << option << std::endl << usage << std::endl;
+			return 1;
+		}
+		std::string value(argv[i + 1]);
+		try
+		{
+			if(option == "--min-rows")
+				min_rows = std::stoul(value);
+			else if(option == "--max-rows")
+				max_rows = std::stoul(value);
+			else if(option == "--seed")
+				seed = std::stoull(value);
+			else if(option == "--min-time")
+				min_time = std::stod(value);
+			else if(option == "--dir")
+				dir = value;
+			else if(option == "--out")
+				out_path = value;
+			else
+			{
+				std::cerr << "Unknown option " << option << std::endl << usage << std::endl;
+				return 1;
+			}
+		}
+		catch(const std::exception&)
+		{
+			std::cerr << "Invalid value " << value << " of option " << option << std::endl << usage << std::endl;
+			return 1;
+		}
+	}
+
+	// the messages of the project are silenced during the benchmarks
+	project::LOG::level log_level = project::LOG::get_level();
+	project::LOG::let_level(project::LOG::level::off);
+
+	std::vector<result> results;
+	std::cerr << "microbenchmarks" << std::endl;
+	micro_benchmarks(results, seed, min_time);
+	for(std::size_t rows = min_rows; rows <= max_rows; rows *= 10)
+	{
+		std::cerr << rows << " rows" << std::endl;
+		data_benchmarks(results, rows, seed, min_time, dir);
+	}
+
+	project::LOG::let_level(log_level);
+
+	if(out_path.empty())
+	{
+		print_json(std::cout, results, seed);
+	}
+	else
+	{
+		std::ofstream file(out_path);
+		print_json(file, results, seed);
+		std::cerr << "results written to " << out_path << std::endl;
+	}
+	return 0;
+}
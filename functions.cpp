@@ -3,6 +3,14 @@
 #include "vol_surface.hpp"
 #include "functions.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PROJECT_HAS_MMAP
+#endif
+
 
 	/* -------------------------------- */
 	/* ---- MANIPULATING STRUCT TM ---- */
@@ -11,37 +19,37 @@
 // for comparing std::tm structures (eg. in iterators)
 bool operator==(const struct std::tm& lhs, const struct std::tm& rhs)
 {
-	return std::tie(lhs.tm_year, lhs.tm_mon, lhs.tm_mday) ==
-		   std::tie(rhs.tm_year, rhs.tm_mon, rhs.tm_mday);
+	return project::TS::to_days(lhs) == project::TS::to_days(rhs);
 }
 
-bool operator>(struct std::tm& lhs, struct std::tm& rhs)
+bool operator>(const struct std::tm& lhs, const struct std::tm& rhs)
 {
-	return (std::difftime(lhs, rhs) > 0.0);
+	return project::TS::to_days(lhs) > project::TS::to_days(rhs);
 }
 
-bool operator<(struct std::tm& lhs, struct std::tm& rhs)
+bool operator<(const struct std::tm& lhs, const struct std::tm& rhs)
 {
-	return (std::difftime(lhs, rhs) < 0.0);
+	return project::TS::to_days(lhs) < project::TS::to_days(rhs);
 }
 
-bool operator>=(struct std::tm& lhs, struct std::tm& rhs)
+bool operator>=(const struct std::tm& lhs, const struct std::tm& rhs)
 {
-	return ((lhs == rhs) | (lhs > rhs));
+	return !(lhs < rhs);
 }
 
-bool operator<=(struct std::tm& lhs, struct std::tm& rhs)
+bool operator<=(const struct std::tm& lhs, const struct std::tm& rhs)
 {
-	return ((lhs == rhs) | (lhs < rhs));
+	return !(lhs > rhs);
 }
 
 
 // overloads for std::tm
 namespace std
 {
-	double difftime(struct std::tm& time_end, struct std::tm& time_beg)
+	double difftime(const struct std::tm& time_end, const struct std::tm& time_beg)
 	{
-		return difftime(std::mktime(&time_end), std::mktime(&time_beg));
+		// dates have no time of the day: difference of day numbers in seconds
+		return (project::TS::to_days(time_end) - project::TS::to_days(time_beg)) * 86400.0;
 	}
 	
 	double difftime(const std::string& time_end, const std::string& time_beg)
@@ -59,10 +67,9 @@ namespace project
 	{
 		
 		// returns a maturity in years using difftime overload (ACT/365 basis)
-		double maturity(struct std::tm& end, struct std::tm& start)
+		double maturity(const struct std::tm& end, const struct std::tm& start)
 		{
-			double difftime = std::difftime(end, start);
-			return TS::difftime_to_years(difftime); // base ACT/365 for simplicity (see TS::difftime_to_years)
+			return maturity(TS::to_days(end), TS::to_days(start)); // base ACT/365 for simplicity
 		}
 		
 		
@@ -80,8 +87,7 @@ namespace project
 		// normal probability distribution
 		double normal_pdf(double x)
 		{
-		   // using existing std atan function
-		   return std::exp(-x * x * 0.5) / std::sqrt(8.0 * std::atan(1.0));
+		   return std::exp(-x * x * 0.5) * 0.39894228040143267794; // 1 / sqrt(2 pi)
 		}
 		
 		/* -------------------------------- */
@@ -143,6 +149,453 @@ namespace project
 				return -S * normal_pdf(d) * v / 2 / std::sqrt(T) + r * K * std::exp(-r * T) * normal_cdf(v * std::sqrt(T) - d);
 		}
 		
+		
+		
+		/* -------------------------------------- */
+		/* ---- BATCH BLACK-SCHOLES FORMULAS ---- */
+		/* -------------------------------------- */
+		
+		// The functions below have no branch and no call to the standard library (except std::sqrt)
+		// so that the compiler can vectorize the loops of batch_bs (AVX2 / AVX-512 with -march=native)
+		namespace
+		{
+			// bit level conversions (std::memcpy is optimized away)
+			inline double from_bits(std::uint64_t bits)
+			{
+				double x;
+				std::memcpy(&x, &bits, sizeof(x));
+				return x;
+			}
+			
+			inline std::uint64_t to_bits(double x)
+			{
+				std::uint64_t bits;
+				std::memcpy(&bits, &x, sizeof(bits));
+				return bits;
+			}
+			
+			inline float from_bits32(std::uint32_t bits)
+			{
+				float x;
+				std::memcpy(&x, &bits, sizeof(x));
+				return x;
+			}
+			
+			inline std::uint32_t to_bits32(float x)
+			{
+				std::uint32_t bits;
+				std::memcpy(&bits, &x, sizeof(bits));
+				return bits;
+			}
+			
+			// exp(x) = 2^k * exp(y) with |y| <= log(2) / 2 and a Taylor polynomial for exp(y)
+			// of degree 13 (full, relative error ~1e-16), 9 (high, ~1e-11) or 7 (fast, ~5e-9)
+			template<accuracy A = accuracy::full>
+			inline double simd_exp(double x)
+			{
+				x = (x < -708.0) ? -708.0 : ((x > 709.0) ? 709.0 : x); // 2^k stays a normal double
+				double k = std::nearbyint(x * 1.4426950408889634); // x / log(2)
+				double y = (x - k * 6.93147180369123816490e-01) - k * 1.90821492927058770002e-10; // log(2) in two parts
+				
+				// Horner scheme from the highest degree of the tier
+				double p;
+				if(A == accuracy::fast)
+					p = 1.0 / 5040.0;
+				else
+				{
+					if(A == accuracy::full)
+					{
+						p = 1.0 / 6227020800.0;
+						p = p * y + 1.0 / 479001600.0;
+						p = p * y + 1.0 / 39916800.0;
+						p = p * y + 1.0 / 3628800.0;
+						p = p * y + 1.0 / 362880.0;
+					}
+					else
+						p = 1.0 / 362880.0;
+					p = p * y + 1.0 / 40320.0;
+					p = p * y + 1.0 / 5040.0;
+				}
+				p = p * y + 1.0 / 720.0;
+				p = p * y + 1.0 / 120.0;
+				p = p * y + 1.0 / 24.0;
+				p = p * y + 1.0 / 6.0;
+				p = p * y + 0.5;
+				p = p * y + 1.0;
+				p = p * y + 1.0;
+				
+				// 2^k built in the exponent bits (k is in the low bits of k + 1.5 * 2^52)
+				std::uint64_t bits = to_bits(k + 6755399441055744.0);
+				return p * from_bits((bits + 1023) << 52);
+			}
+			
+			// log(x) = e * log(2) + log(m) with m in [sqrt(2)/2, sqrt(2)) (x positive and normal)
+			// log(m) = 2 * atanh(f) with f = (m - 1) / (m + 1), |f| < 0.172
+			inline double simd_log(double x)
+			{
+				std::uint64_t bits = to_bits(x);
+				double e = from_bits(0x4330000000000000ULL | (bits >> 52)) - 4503599627370496.0 - 1023.0; // exponent
+				double m = from_bits((bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL); // mantissa in [1, 2)
+				bool high = m > 1.4142135623730951;
+				m = high ? m * 0.5 : m;
+				e = high ? e + 1.0 : e;
+				
+				double f = (m - 1.0) / (m + 1.0);
+				double f2 = f * f;
+				double p = 1.0 / 23.0;
+				p = p * f2 + 1.0 / 21.0;
+				p = p * f2 + 1.0 / 19.0;
+				p = p * f2 + 1.0 / 17.0;
+				p = p * f2 + 1.0 / 15.0;
+				p = p * f2 + 1.0 / 13.0;
+				p = p * f2 + 1.0 / 11.0;
+				p = p * f2 + 1.0 / 9.0;
+				p = p * f2 + 1.0 / 7.0;
+				p = p * f2 + 1.0 / 5.0;
+				p = p * f2 + 1.0 / 3.0;
+				p = p * f2 + 1.0;
+				
+				return e * 6.93147180369123816490e-01 + (2.0 * f * p + e * 1.90821492927058770002e-10);
+			}
+			
+			// normal cumulative distribution: Hart (1968) double precision approximation (see West, 2005)
+			// absolute error ~1e-16, both branches are computed and selected
+			// high: same rational approximation with a shorter exp, and no continued fraction for the tail
+			// (the cdf is within 1e-12 of 0 or 1 beyond 7.07): absolute error ~1e-11
+			// fast: Abramowitz & Stegun 26.2.17, absolute error ~1e-7
+			template<accuracy A = accuracy::full>
+			inline double simd_normal_cdf(double x)
+			{
+				double a = std::fabs(x);
+				double e = simd_exp<A>(-0.5 * a * a);
+				
+				if(A == accuracy::fast)
+				{
+					double t = 1.0 / (1.0 + 0.2316419 * a);
+					double p = 1.330274429 * t - 1.821255978;
+					p = p * t + 1.781477937;
+					p = p * t - 0.356563782;
+					p = p * t + 0.319381530;
+					double tail = 0.39894228040143267794 * e * p * t;
+					return (x > 0.0) ? 1.0 - tail : tail;
+				}
+				
+				// rational approximation for |x| < 7.07
+				double num = 3.52624965998911e-02 * a + 0.700383064443688;
+				num = num * a + 6.37396220353165;
+				num = num * a + 33.912866078383;
+				num = num * a + 112.079291497871;
+				num = num * a + 221.213596169931;
+				num = num * a + 220.206867912376;
+				double den = 8.83883476483184e-02 * a + 1.75566716318264;
+				den = den * a + 16.064177579207;
+				den = den * a + 86.7807322029461;
+				den = den * a + 296.564248779674;
+				den = den * a + 637.333633378831;
+				den = den * a + 793.826512519948;
+				den = den * a + 440.413735824752;
+				
+				if(A == accuracy::high)
+				{
+					double tail = (a < 7.07106781186547) ? e * num / den : 0.0;
+					return (x > 0.0) ? 1.0 - tail : tail;
+				}
+				
+				// continued fraction for the tail
+				double cf = a + 0.65;
+				cf = a + 4.0 / cf;
+				cf = a + 3.0 / cf;
+				cf = a + 2.0 / cf;
+				cf = a + 1.0 / cf;
+				
+				double tail = (a < 7.07106781186547) ? e * num / den : e / cf / 2.506628274631;
+				tail = (a < 37.0) ? tail : 0.0;
+				return (x > 0.0) ? 1.0 - tail : tail;
+			}
+			
+			// single precision exp (accuracy::single): same reduction as simd_exp, Taylor polynomial of degree 6
+			// (relative error ~2e-7), not below exp(-80) so that the tails of the normal distributions stay normal
+			// floats (no slow denormal arithmetic)
+			inline float simd_exp_single(float x)
+			{
+				x = (x < -80.0f) ? -80.0f : ((x > 88.0f) ? 88.0f : x);
+				float k = std::nearbyint(x * 1.44269504f);
+				float y = (x - k * 0.693359375f) + k * 2.12194440e-4f; // log(2) in two parts
+				
+				float p = 1.0f / 720.0f;
+				p = p * y + 1.0f / 120.0f;
+				p = p * y + 1.0f / 24.0f;
+				p = p * y + 1.0f / 6.0f;
+				p = p * y + 0.5f;
+				p = p * y + 1.0f;
+				p = p * y + 1.0f;
+				
+				// 2^k built in the exponent bits (k is in the low bits of k + 1.5 * 2^23)
+				std::uint32_t bits = to_bits32(k + 12582912.0f);
+				return p * from_bits32((bits + 127u) << 23);
+			}
+			
+			// single precision normal cumulative distribution: Abramowitz & Stegun 26.2.17 as the fast tier
+			inline float simd_normal_cdf_single(float x)
+			{
+				float a = std::fabs(x);
+				float e = simd_exp_single(-0.5f * a * a);
+				float t = 1.0f / (1.0f + 0.2316419f * a);
+				float p = 1.330274429f * t - 1.821255978f;
+				p = p * t + 1.781477937f;
+				p = p * t - 0.356563782f;
+				p = p * t + 0.319381530f;
+				float tail = 0.398942280f * e * p * t;
+				return (x > 0.0f) ? 1.0f - tail : tail;
+			}
+			
+			// scalar type and normal distributions of a tier (d1 and d2 are computed in double by batch_bs)
+			template<accuracy A>
+			struct tier
+			{
+				using scalar = double;
+				static double cdf(double x)
+				{
+					return simd_normal_cdf<A>(x);
+				}
+				static double pdf(double x)
+				{
+					return simd_exp<A>(-0.5 * x * x) * 0.39894228040143267794;
+				}
+			};
+			
+			template<>
+			struct tier<accuracy::single>
+			{
+				using scalar = float;
+				static float cdf(float x)
+				{
+					return simd_normal_cdf_single(x);
+				}
+				static float pdf(float x)
+				{
+					return simd_exp_single(-0.5f * x * x) * 0.398942280f;
+				}
+			};
+			
+			// accessor for a parameter common to all the options (same syntax as a pointer)
+			struct common
+			{
+				double value;
+				double operator[](std::size_t) const { return value; }
+			};
+			
+			// fused kernel, on blocks so that each intermediate result stays in the cache
+			// the accuracy only changes the normal distributions (log and discount factor stay in full precision),
+			// computed in the scalar type of the tier
+			template<accuracy A, typename S_type, typename K_type, typename T_type, typename R_type, typename V_type>
+			void batch_bs_kernel(std::size_t n, S_type S, K_type K, T_type T, R_type r, V_type v,
+								 const bs_outputs& out, bool call)
+			{
+				using scalar = typename tier<A>::scalar;
+				const std::size_t block = 256;
+				double sqrt_t[block], d1[block], d2[block], disc[block];
+				scalar cdf_d1[block], cdf_d2[block], pdf_d1[block];
+				
+				// intermediate results needed by the requested outputs
+				bool need_cdf_d1 = out.price || out.delta;
+				bool need_cdf_d2 = out.price || out.rho || out.theta;
+				bool need_pdf = out.gamma || out.vega || out.theta;
+				bool need_disc = out.price || out.rho || out.theta;
+				
+				for(std::size_t b = 0; b < n; b += block)
+				{
+					std::size_t m = std::min(block, n - b);
+					
+
+					// d1 and d2
+					for(std::size_t i = 0; i < m; ++i)
+					{
+						sqrt_t[i] = std::sqrt(T[b + i]);
+						double vol = v[b + i];
+						double v_sqrt_t = vol * sqrt_t[i];
+						d1[i] = (simd_log(S[b + i] / K[b + i]) + T[b + i] * (r[b + i] + 0.5 * vol * vol)) / v_sqrt_t;
+						d2[i] = d1[i] - v_sqrt_t;
+					}
+					
+					// normal distributions and discount factor
+					if(need_cdf_d1)
+						for(std::size_t i = 0; i < m; ++i)
+							cdf_d1[i] = tier<A>::cdf(static_cast<scalar>(d1[i]));
+					if(need_cdf_d2)
+						for(std::size_t i = 0; i < m; ++i)
+							cdf_d2[i] = tier<A>::cdf(static_cast<scalar>(d2[i]));
+					if(need_pdf)
+						for(std::size_t i = 0; i < m; ++i)
+							pdf_d1[i] = tier<A>::pdf(static_cast<scalar>(d1[i]));
+					if(need_disc)
+						for(std::size_t i = 0; i < m; ++i)
+							disc[i] = simd_exp(-r[b + i] * T[b + i]);
+					
+					// outputs (same formulas as the scalar versions, puts from call-put parity)
+					if(out.price)
+						for(std::size_t i = 0; i < m; ++i)
+						{
+							double price = S[b + i] * cdf_d1[i] - disc[i] * K[b + i] * cdf_d2[i];
+							out.price[b + i] = call ? price : price - S[b + i] + K[b + i] * disc[i];
+						}
+					if(out.delta)
+						for(std::size_t i = 0; i < m; ++i)
+							out.delta[b + i] = call ? cdf_d1[i] : cdf_d1[i] - 1.0;
+					if(out.gamma)
+						for(std::size_t i = 0; i < m; ++i)
+							out.gamma[b + i] = pdf_d1[i] / S[b + i] / v[b + i] / sqrt_t[i];
+					if(out.vega)
+						for(std::size_t i = 0; i < m; ++i)
+							out.vega[b + i] = S[b + i] * pdf_d1[i] * sqrt_t[i];
+					if(out.rho)
+						for(std::size_t i = 0; i < m; ++i)
+						{
+							double rho = T[b + i] * K[b + i] * disc[i];
+							out.rho[b + i] = call ? rho * cdf_d2[i] : -rho * (1.0 - cdf_d2[i]);
+						}
+					if(out.theta)
+						for(std::size_t i = 0; i < m; ++i)
+						{
+							double decay = -S[b + i] * pdf_d1[i] * v[b + i] / 2.0 / sqrt_t[i];
+							double carry = r[b + i] * K[b + i] * disc[i];
+							out.theta[b + i] = call ? decay - carry * cdf_d2[i] : decay + carry * (1.0 - cdf_d2[i]);
+						}
+				}
+			}
+			
+			// vector normal distributions (in double or in float, computed in the scalar type of the tier)
+			template<accuracy A, typename T>
+			void batch_normal_kernel(std::size_t n, const T* x, T* out, bool cdf)
+			{
+				using scalar = typename tier<A>::scalar;
+				if(cdf)
+					for(std::size_t i = 0; i < n; ++i)
+						out[i] = tier<A>::cdf(static_cast<scalar>(x[i]));
+				else
+					for(std::size_t i = 0; i < n; ++i)
+						out[i] = tier<A>::pdf(static_cast<scalar>(x[i]));
+			}
+			
+			void batch_normal_dispatch(std::size_t n, const double* x, double* out, bool cdf, accuracy acc)
+			{
+				switch(acc)
+				{
+					case accuracy::high:
+						batch_normal_kernel<accuracy::high>(n, x, out, cdf);
+						break;
+					case accuracy::fast:
+						batch_normal_kernel<accuracy::fast>(n, x, out, cdf);
+						break;
+					case accuracy::single:
+						batch_normal_kernel<accuracy::single>(n, x, out, cdf);
+						break;
+					default:
+						batch_normal_kernel<accuracy::full>(n, x, out, cdf);
+				}
+			}
+			
+			// one instantiation of the kernel per accuracy
+			template<typename S_type, typename K_type, typename T_type, typename R_type, typename V_type>
+			void batch_bs_dispatch(std::size_t n, S_type S, K_type K, T_type T, R_type r, V_type v,
+								   const bs_outputs& out, bool call, accuracy acc)
+			{
+				switch(acc)
+				{
+					case accuracy::high:
+						batch_bs_kernel<accuracy::high>(n, S, K, T, r, v, out, call);
+						break;
+					case accuracy::fast:
+						batch_bs_kernel<accuracy::fast>(n, S, K, T, r, v, out, call);
+						break;
+					case accuracy::single:
+						batch_bs_kernel<accuracy::single>(n, S, K, T, r, v, out, call);
+						break;
+					default:
+						batch_bs_kernel<accuracy::full>(n, S, K, T, r, v, out, call);
+				}
+			}
+		}
+		
+		
+		// normal distributions with a selectable accuracy
+		double normal_cdf(double x, accuracy acc)
+		{
+			switch(acc)
+			{
+				case accuracy::high: return simd_normal_cdf<accuracy::high>(x);
+				case accuracy::fast: return simd_normal_cdf<accuracy::fast>(x);
+				case accuracy::single: return simd_normal_cdf_single(static_cast<float>(x));
+				default: return normal_cdf(x);
+			}
+		}
+		
+		double normal_pdf(double x, accuracy acc)
+		{
+			switch(acc)
+			{
+				case accuracy::high: return simd_exp<accuracy::high>(-x * x * 0.5) * 0.39894228040143267794;
+				case accuracy::fast: return simd_exp<accuracy::fast>(-x * x * 0.5) * 0.39894228040143267794;
+				case accuracy::single: return tier<accuracy::single>::pdf(static_cast<float>(x));
+				default: return normal_pdf(x);
+			}
+		}
+		
+		
+		void batch_normal_cdf(std::size_t n, const double* x, double* out, accuracy acc)
+		{
+			batch_normal_dispatch(n, x, out, true, acc);
+		}
+		
+		void batch_normal_pdf(std::size_t n, const double* x, double* out, accuracy acc)
+		{
+			batch_normal_dispatch(n, x, out, false, acc);
+		}
+		
+		void batch_normal_cdf(std::size_t n, const float* x, float* out)
+		{
+			batch_normal_kernel<accuracy::single>(n, x, out, true);
+		}
+		
+		void batch_normal_pdf(std::size_t n, const float* x, float* out)
+		{
+			batch_normal_kernel<accuracy::single>(n, x, out, false);
+		}
+		
+		void batch_exp(std::size_t n, const double* x, double* out)
+		{
+			for(std::size_t i = 0; i < n; ++i)
+				out[i] = simd_exp(x[i]);
+		}
+		
+		void batch_log(std::size_t n, const double* x, double* out)
+		{
+			for(std::size_t i = 0; i < n; ++i)
+				out[i] = simd_log(x[i]);
+		}
+		
+		
+		// batch Black-Scholes: price and greeks of n options in one pass
+		void batch_bs(std::size_t n, const double* S, const double* K, const double* T, const double* r, const double* v,
+					  const bs_outputs& out, bool call, accuracy acc)
+		{
+			batch_bs_dispatch(n, S, K, T, r, v, out, call, acc);
+		}
+		
+		// same with strike, rate and volatility common to all the options (eg. along a hedging path)
+		void batch_bs(std::size_t n, const double* S, double K, const double* T, double r, double v,
+					  const bs_outputs& out, bool call, accuracy acc)
+		{
+			batch_bs_dispatch(n, S, common{K}, T, common{r}, common{v}, out, call, acc);
+		}
+		
+		// same with spot, maturity and rate common to all the options (eg. one day of several hedging paths)
+		void batch_bs(std::size_t n, double S, const double* K, double T, double r, const double* v,
+					  const bs_outputs& out, bool call, accuracy acc)
+		{
+			batch_bs_dispatch(n, common{S}, K, common{T}, common{r}, v, out, call, acc);
+		}
+		
 	}
 
 	
@@ -152,10 +605,26 @@ namespace project
 	
 	namespace TS
 	{
+		// day number to std::tm
+		struct std::tm to_tm(day_t days)
+		{
+			civil_date date = civil_from_days(days);
+			struct std::tm tm = {};
+			tm.tm_year = date.year - 1900;
+			tm.tm_mon = date.month - 1;
+			tm.tm_mday = date.day;
+			tm.tm_wday = ((days % 7) + 11) % 7; // 01/01/1970 was a thursday
+			tm.tm_yday = days - days_from_civil(date.year, 1, 1);
+			tm.tm_isdst = -1;
+			return tm;
+		}
+		
+		
+		
 		// string to std::tm function
 		struct std::tm to_date(const std::string& strdate)
 		{
-			struct std::tm tm;
+			struct std::tm tm = {};
 			std::istringstream datestream(strdate);
 			datestream >> std::get_time(&tm, "%d/%m/%Y");
 			
@@ -166,6 +635,12 @@ namespace project
 			return tm;
 		}
 		
+		// string to day number
+		day_t to_days(const std::string& strdate)
+		{
+			return to_days(to_date(strdate));
+		}
+		
 		
 		
 		// convert a difftime (which is in seconds)
@@ -220,8 +695,8 @@ namespace project
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
-				std::cout << "Error: file could not be reset!" << std::endl;
+				PROJECT_LOG_ERROR(msg);
+				PROJECT_LOG_ERROR("Error: file could not be reset!");
 			}
 		}
 		
@@ -243,14 +718,14 @@ namespace project
 				}
 				catch(const char* msg)
 				{
-					std::cerr << msg << std::endl;
+					PROJECT_LOG_ERROR(msg);
 				}
 				
 				return nb_lines;
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
+				PROJECT_LOG_ERROR(msg);
 				return 0;
 			}
 		}
@@ -269,6 +744,8 @@ namespace project
 				while(csv_file.good())
 				{
 					std::getline(csv_file, text, '\n');
+					if(i == 0) // the first line may start with a byte order mark
+						text = text.substr(bom_size(text.data(), text.size()));
 					if(!text.empty())
 						std::cout << ++i << " - " << text << std::endl;
 				}
@@ -280,12 +757,12 @@ namespace project
 				}
 				catch(const char* msg)
 				{
-					std::cerr << msg << std::endl;
+					PROJECT_LOG_ERROR(msg);
 				}
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
+				PROJECT_LOG_ERROR(msg);
 			}
 		}
 		
@@ -302,8 +779,8 @@ namespace project
 				while(csv_file.good() && (i++ < line))
 					std::getline(csv_file, text, '\n');
 				
-				if(line==1) // first date has some additionnal characters
-					text = text.substr(3);
+				if(line==1) // the first line may start with a byte order mark
+					text = text.substr(bom_size(text.data(), text.size()));
 				
 				std::cout << line << " - " << text << std::endl;
 				
@@ -314,14 +791,263 @@ namespace project
 				}
 				catch(const char* msg)
 				{
-					std::cerr << msg << std::endl;
+					PROJECT_LOG_ERROR(msg);
 				}
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
+				PROJECT_LOG_ERROR(msg);
 			}
 		}
+		
+		// read-only view on a whole file
+		mapped_file::mapped_file(const std::string& path)
+			: m_data(nullptr), m_size(0), m_mapped(false)
+		{
+#ifdef PROJECT_HAS_MMAP
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if(fd < 0)
+				throw "Error: file could not be opened!";
+			
+			struct stat info;
+			if(::fstat(fd, &info) == 0 && info.st_size > 0)
+			{
+				m_size = static_cast<std::size_t>(info.st_size);
+				void* address = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(address != MAP_FAILED)
+				{
+					m_data = static_cast<const char*>(address);
+					m_mapped = true;
+				}
+			}
+			::close(fd); // the mapping stays valid
+			if(m_mapped || m_size == 0)
+				return;
+#endif
+			// no mapping: the file is copied in memory
+			std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+			if(!file.is_open())
+				throw "Error: file could not be opened!";
+			m_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			m_data = m_buffer.data();
+			m_size = m_buffer.size();
+		}
+		
+		mapped_file::~mapped_file()
+		{
+#ifdef PROJECT_HAS_MMAP
+			if(m_mapped)
+				::munmap(const_cast<char*>(m_data), m_size);
+#endif
+		}
+		
+		const char* mapped_file::data() const
+		{
+			return m_data;
+		}
+		
+		std::size_t mapped_file::size() const
+		{
+			return m_size;
+		}
+		
+		
+		// size of the UTF-8 byte order mark (EF BB BF)
+		std::size_t bom_size(const char* text, std::size_t size)
+		{
+			return (size >= 3 && std::memcmp(text, "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+		}
+		
+		
+		// dd/mm/yyyy (days and months on 1 or 2 digits, as std::get_time)
+		const char* parse_date(const char* first, const char* last, TS::day_t& day)
+		{
+			int fields[3] = {0, 0, 0};
+			const int max_digits[3] = {2, 2, 4};
+			for(int k = 0; k < 3; ++k)
+			{
+				if(k > 0)
+				{
+					if(first == last || *first != '/')
+						return nullptr;
+					++first;
+				}
+				int digits = 0;
+				while(first != last && digits < max_digits[k] && *first >= '0' && *first <= '9')
+				{
+					fields[k] = fields[k] * 10 + (*first++ - '0');
+					++digits;
+				}
+				if(digits == 0)
+					return nullptr;
+			}
+			if(fields[0] < 1 || fields[0] > 31 || fields[1] < 1 || fields[1] > 12)
+				return nullptr;
+			
+			day = TS::days_from_civil(fields[2], fields[1], fields[0]);
+			return first;
+		}
+		
+		
+		// decimal number: [sign] digits [. digits] [e [sign] digits]
+		// when the significant digits fit in a double and the power of 10 is exact (Clinger's fast path),
+		// one multiplication or division gives the correctly rounded result, as std::strtod
+		// otherwise (very rare in price data) the field is given to std::strtod
+		const char* parse_double(const char* first, const char* last, double& value)
+		{
+			static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+											1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+			const char* p = first;
+			bool negative = false;
+			if(p != last && (*p == '-' || *p == '+'))
+				negative = (*p++ == '-');
+			
+			std::uint64_t mantissa = 0;
+			int exponent = 0, significant = 0;
+			bool any_digit = false, exact = true;
+			
+			// integer part then fractional part
+			for(int part = 0; part < 2; ++part)
+			{
+				if(part == 1)
+				{
+					if(p == last || *p != '.')
+						break;
+					++p;
+				}
+				while(p != last && *p >= '0' && *p <= '9')
+				{
+					int digit = *p++ - '0';
+					any_digit = true;
+					if(significant < 19) // no overflow of the mantissa
+					{
+						mantissa = mantissa * 10 + static_cast<std::uint64_t>(digit);
+						significant += (mantissa != 0) ? 1 : 0;
+						exponent -= part;
+					}
+					else
+					{
+						exact &= (digit == 0);
+						exponent += 1 - part;
+					}
+				}
+			}
+			if(!any_digit)
+				return nullptr;
+			
+			// exponent
+			if(p != last && (*p == 'e' || *p == 'E'))
+			{
+				const char* q = p + 1;
+				bool negative_exp = false;
+				if(q != last && (*q == '-' || *q == '+'))
+					negative_exp = (*q++ == '-');
+				int e = 0;
+				bool any_exp_digit = false;
+				while(q != last && *q >= '0' && *q <= '9')
+				{
+					e = std::min(e * 10 + (*q++ - '0'), 100000);
+					any_exp_digit = true;
+				}
+				if(any_exp_digit)
+				{
+					exponent += negative_exp ? -e : e;
+					p = q;
+				}
+			}
+			
+			if(exact && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22)
+			{
+				double m = static_cast<double>(mantissa);
+				value = (exponent < 0) ? m / powers[-exponent] : m * powers[exponent];
+				value = negative ? -value : value;
+			}
+			else
+			{
+				std::string field(first, p); // std::strtod needs a null-terminated string
+				value = std::strtod(field.c_str(), nullptr);
+			}
+			return p;
+		}
+		
+		
+		
+		// dd/mm/yyyy (days and months on 2 digits, as parse_date reads them)
+		char* format_date(char* first, TS::day_t day)
+		{
+			TS::civil_date date = TS::civil_from_days(day);
+			int year = std::min(std::max(date.year, 0), 9999);
+			first[0] = static_cast<char>('0' + date.day / 10);
+			first[1] = static_cast<char>('0' + date.day % 10);
+			first[2] = '/';
+			first[3] = static_cast<char>('0' + date.month / 10);
+			first[4] = static_cast<char>('0' + date.month % 10);
+			first[5] = '/';
+			for(int k = 9; k >= 6; --k, year /= 10)
+				first[k] = static_cast<char>('0' + year % 10);
+			return first + 10;
+		}
+		
+		// fixed point with the decimals that keep the significant digits (up to 17 decimals): the value is
+		// rounded to an integer number of 10^-decimals and written with integer arithmetic (much faster than
+		// a stream); values too large or too small for it are given to std::snprintf
+		char* format_double(char* first, double value, int digits)
+		{
+			static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+											1e12, 1e13, 1e14, 1e15, 1e16, 1e17};
+			digits = std::min(std::max(digits, 1), 17);
+			int decimals = digits;
+			double scaled = std::abs(value) * powers[decimals];
+			while((decimals > 0) && (scaled >= powers[digits]))
+				scaled = std::abs(value) * powers[--decimals];
+			while((decimals < 17) && (scaled < powers[digits - 1]) && (value != 0.0))
+				scaled = std::abs(value) * powers[++decimals];
+			if(!(scaled < 1e18) || ((scaled < powers[digits - 1]) & (value != 0.0)))
+			{
+				int written = std::snprintf(first, format_size, "%.*g", digits, value);
+				return first + std::max(written, 0);
+			}
+			
+			std::uint64_t units = static_cast<std::uint64_t>(scaled + 0.5);
+			std::uint64_t scale = static_cast<std::uint64_t>(powers[decimals]);
+			std::uint64_t integer = units / scale, fraction = units % scale;
+			if((value < 0.0) & (units != 0))
+				*first++ = '-';
+			
+			// integer part (digits written backwards)
+			char reversed[20];
+			int n = 0;
+			do
+			{
+				reversed[n++] = static_cast<char>('0' + integer % 10);
+				integer /= 10;
+			}
+			while(integer != 0);
+			while(n > 0)
+				*first++ = reversed[--n];
+			
+			// fractional part without its trailing zeros
+			if(fraction != 0)
+			{
+				int width = decimals;
+				while(fraction % 10 == 0)
+				{
+					fraction /= 10;
+					--width;
+				}
+				*first++ = '.';
+				for(int k = width - 1; k >= 0; --k, fraction /= 10)
+					first[k] = static_cast<char>('0' + fraction % 10);
+				first += width;
+			}
+			return first;
+		}
+		
+		void append_double(std::string& line, double value, int digits)
+		{
+			char buffer[format_size];
+			line.append(buffer, format_double(buffer, value, digits));
+		}
 	}
 
 }
@@ -338,3 +1064,4 @@ namespace project
 
 
 
+
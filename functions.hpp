@@ -5,6 +5,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
@@ -16,23 +19,26 @@
 #include <tuple>
 #include <vector>
 
+#include "logger.hpp" // messages of the project
+
 
 	/* -------------------------------- */
 	/* ---- MANIPULATING STRUCT TM ---- */
 	/* -------------------------------- */
 
 // for comparing std::tm structures (eg. in iterators)
+// comparisons are done on day numbers (see TS::to_days), no call to std::mktime
 bool operator==(const struct std::tm& lhs, const struct std::tm& rhs);
-bool operator>(struct std::tm& lhs, struct std::tm& rhs);
-bool operator<(struct std::tm& lhs, struct std::tm& rhs);
-bool operator>=(struct std::tm& lhs, struct std::tm& rhs);
-bool operator<=(struct std::tm& lhs, struct std::tm& rhs);
+bool operator>(const struct std::tm& lhs, const struct std::tm& rhs);
+bool operator<(const struct std::tm& lhs, const struct std::tm& rhs);
+bool operator>=(const struct std::tm& lhs, const struct std::tm& rhs);
+bool operator<=(const struct std::tm& lhs, const struct std::tm& rhs);
 
 
 // overloads for std::tm
 namespace std
 {
-	double difftime(struct std::tm& time_end, struct std::tm& time_beg);
+	double difftime(const struct std::tm& time_end, const struct std::tm& time_beg);
 	double difftime(const std::string& time_end, const std::string& time_beg);
 }
 
@@ -42,18 +48,165 @@ namespace project
 {
 	
 	
+	/* ------------------------------- */
+	/* ---- DATES AS DAY NUMBERS ---- */
+	/* ------------------------------- */
+	
+	namespace TS
+	{
+		// compact date representation: number of days since 01/01/1970
+		typedef std::int32_t day_t;
+		
+		// civil date (month in 1 - 12, day in 1 - 31)
+		struct civil_date
+		{
+			int year;
+			int month;
+			int day;
+		};
+		
+		// civil date to day number (proleptic gregorian calendar)
+		constexpr day_t days_from_civil(int year, int month, int day)
+		{
+			year -= (month <= 2) ? 1 : 0;
+			const int era = (year >= 0 ? year : year - 399) / 400;
+			const int yoe = year - era * 400; // year of era [0, 399]
+			const int doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // day of year [0, 365]
+			const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy; // day of era [0, 146096]
+			return era * 146097 + doe - 719468;
+		}
+		
+		// day number to civil date (inverse of days_from_civil)
+		constexpr civil_date civil_from_days(day_t days)
+		{
+			days += 719468;
+			const int era = (days >= 0 ? days : days - 146096) / 146097;
+			const int doe = days - era * 146097; // day of era [0, 146096]
+			const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // year of era [0, 399]
+			const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100); // day of year [0, 365]
+			const int mp = (5 * doy + 2) / 153; // month starting in march [0, 11]
+			const int month = mp < 10 ? mp + 3 : mp - 9;
+			return civil_date{yoe + era * 400 + (month <= 2 ? 1 : 0), month, doy - (153 * mp + 2) / 5 + 1};
+		}
+		
+		// std::tm to day number
+		// out of range months and days are normalized the same way std::mktime does (eg. tm_mon = -1)
+		constexpr day_t to_days(const struct std::tm& tm)
+		{
+			int year = tm.tm_year + 1900 + tm.tm_mon / 12;
+			int month = tm.tm_mon % 12;
+			if(month < 0)
+			{
+				month += 12;
+				year -= 1;
+			}
+			return days_from_civil(year, month + 1, 1) + tm.tm_mday - 1;
+		}
+		
+		// day number to std::tm (time of the day set to zero)
+		struct std::tm to_tm(day_t days);
+		
+		
+		// day-count conventions of the year fractions of a series (ACT/365 by default)
+		// the fractions are tabulated once per series by a kernel templated on the policy below (see
+		// time_series::let_day_count): the hedging loops only read the table, with no branch on the convention
+		enum class day_count
+		{
+			act_365,
+			act_360,
+			act_act, // ISDA: the days of each calendar year over the length of that year
+			bus_252 // trading days of the series (one per new date) over 252
+		};
+		
+		// policies: year_fraction(start, end) between two dates, with additive set when the fraction is only
+		// defined between consecutive lines (the years of a line are then the sum of the previous fractions)
+		struct act_365
+		{
+			static constexpr bool additive = false;
+			static constexpr double year_fraction(day_t start, day_t end)
+			{
+				return (end - start) / 365.0;
+			}
+		};
+		
+		struct act_360
+		{
+			static constexpr bool additive = false;
+			static constexpr double year_fraction(day_t start, day_t end)
+			{
+				return (end - start) / 360.0;
+			}
+		};
+		
+		struct act_act
+		{
+			static constexpr bool additive = false;
+			static double year_fraction(day_t start, day_t end)
+			{
+				if(end < start)
+					return -year_fraction(end, start);
+				int first = civil_from_days(start).year, last = civil_from_days(end).year;
+				if(first == last)
+					return (end - start) / days_in_year(first);
+				return (days_from_civil(first + 1, 1, 1) - start) / days_in_year(first) + (last - first - 1)
+					+ (end - days_from_civil(last, 1, 1)) / days_in_year(last);
+			}
+			static constexpr double days_in_year(int year)
+			{
+				return ((year % 4 == 0) & ((year % 100 != 0) | (year % 400 == 0))) ? 366.0 : 365.0;
+			}
+		};
+		
+		struct bus_252
+		{
+			static constexpr bool additive = true;
+			static constexpr double year_fraction(day_t previous, day_t day) // consecutive lines
+			{
+				return (day != previous) ? 1.0 / 252.0 : 0.0;
+			}
+		};
+	}
+	
+	
+	
+	
 	/* -------------------------------- */
 	/* ---- BLACK-SCHOLES FORMULAS ---- */
 	/* -------------------------------- */	
 	
 	namespace BS
 	{
+		// returns a maturity in years from two day numbers (ACT/365 basis, see TS::day_count for the others)
+		constexpr double maturity(TS::day_t end, TS::day_t start)
+		{
+			return TS::act_365::year_fraction(start, end);
+		}
+		
 		// returns a maturity in years using difftime overload (ACT/365 basis)
-		double maturity(struct std::tm& start, struct std::tm& end);
+		double maturity(const struct std::tm& end, const struct std::tm& start);
+		
+		// accuracy of the normal distributions (see batch_bs)
+		enum class accuracy
+		{
+			full, // double precision (~1e-16)
+			high, // ~1e-11 (measured on [-40, 40]: 2e-12 on the cdf, 3e-12 on the pdf)
+			fast, // ~1e-7
+			single // same approximations as fast in single precision: twice the lanes of the vector units, ~3e-7
+		};
 		
 		// normal distribution
 		double normal_cdf(double x); // using std::erfc
-		double normal_pdf(double x); // using std::atan
+		double normal_pdf(double x);
+		double normal_cdf(double x, accuracy acc); // branch-free approximations of batch_bs (std::erfc for full)
+		double normal_pdf(double x, accuracy acc);
+		
+		// normal distributions, exp and log (positive values) of n values in one pass (same approximations as batch_bs)
+		void batch_normal_cdf(std::size_t n, const double* x, double* out, accuracy acc = accuracy::full);
+		void batch_normal_pdf(std::size_t n, const double* x, double* out, accuracy acc = accuracy::full);
+		void batch_normal_cdf(std::size_t n, const float* x, float* out); // accuracy::single
+		void batch_normal_pdf(std::size_t n, const float* x, float* out);
+		void batch_exp(std::size_t n, const double* x, double* out);
+		void batch_log(std::size_t n, const double* x, double* out);
 		
 		// Black-Scholes formulas
 		double price_bs(double S, double K, double T, double r, double v, bool call = true);
@@ -62,6 +215,30 @@ namespace project
 		double vega_bs(double S, double K, double T, double r, double v, bool call = true);
 		double rho_bs(double S, double K, double T, double r, double v, bool call = true);
 		double theta_bs(double S, double K, double T, double r, double v, bool call = true);
+		
+		
+		// batch Black-Scholes: price and greeks of n options in one pass
+		// d1, d2, the normal distributions and the discount factor are computed once for all the outputs,
+		// with branch-free log / exp / normal_cdf approximations (accuracy ~1e-16) the compiler can vectorize
+		// the normal distributions can be traded for cheaper approximations (acc): a breakeven vol solved
+		// to 1e-5 does not need them to 1e-16
+		// outputs set to nullptr are not computed
+		struct bs_outputs
+		{
+			double* price = nullptr;
+			double* delta = nullptr;
+			double* gamma = nullptr;
+			double* vega = nullptr;
+			double* rho = nullptr;
+			double* theta = nullptr;
+		};
+		
+		void batch_bs(std::size_t n, const double* S, const double* K, const double* T, const double* r, const double* v,
+					  const bs_outputs& out, bool call = true, accuracy acc = accuracy::full);
+		void batch_bs(std::size_t n, const double* S, double K, const double* T, double r, double v, // common K, r, v
+					  const bs_outputs& out, bool call = true, accuracy acc = accuracy::full);
+		void batch_bs(std::size_t n, double S, const double* K, double T, double r, const double* v, // common S, T, r
+					  const bs_outputs& out, bool call = true, accuracy acc = accuracy::full);
 
 	}
 	
@@ -77,6 +254,9 @@ namespace project
 		// string to std::tm
 		struct std::tm to_date(const std::string& strdate);
 		
+		// string to day number
+		day_t to_days(const std::string& strdate);
+		
 		// convert a difftime (which is in seconds)
 		double difftime_to_days(double difftime);
 		double difftime_to_years(double difftime); // basis ACT/365
@@ -109,6 +289,49 @@ namespace project
 
 		// prints only the requested line from the csv file
 		void print_line(std::ifstream& csv_file, std::size_t line); 
+		
+		
+		// read-only view on a whole file, memory-mapped when the system allows it (copied in memory otherwise)
+		class mapped_file
+		{
+		public:
+			
+			// constructors (throws if the file can not be opened)
+			explicit mapped_file(const std::string& path);
+			
+			// destructor (unmaps the file)
+			~mapped_file();
+			
+			// no copy
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator=(const mapped_file&) = delete;
+			
+			// access
+			const char* data() const;
+			std::size_t size() const;
+			
+		private:
+			
+			const char* m_data;
+			std::size_t m_size;
+			bool m_mapped;
+			std::vector<char> m_buffer; // copy of the file when it is not mapped
+		};
+		
+		// size of the UTF-8 byte order mark at the beginning of the text (0 if there is none)
+		std::size_t bom_size(const char* text, std::size_t size);
+		
+		// parsers on the characters [first, last) (no copy, no locale)
+		// return the position after the parsed field, or nullptr if the field is not valid
+		const char* parse_date(const char* first, const char* last, TS::day_t& day); // dd/mm/yyyy
+		const char* parse_double(const char* first, const char* last, double& value);
+		
+		// formatters at first (no locale), return the position after the written field
+		// the buffer must hold format_size characters
+		const std::size_t format_size = 32;
+		char* format_date(char* first, TS::day_t day); // dd/mm/yyyy
+		char* format_double(char* first, double value, int digits = 10); // significant digits, no trailing zeros
+		void append_double(std::string& line, double value, int digits = 10);
 	}
 
 }
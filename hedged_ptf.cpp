@@ -17,11 +17,22 @@ namespace project
 		// constructors
 		hedged_ptf::hedged_ptf(const std::string& name, std::ifstream& csv_file,
 							   double strike, double rate, double div)
-			: m_ts(name, csv_file), m_strike(strike), m_rate(rate), m_div(div)
+			: m_ts(name, csv_file), m_strike(strike), m_rate(rate), m_div(div), m_accuracy(accuracy::full)
 		{
 			// time_series object are base 1
 			m_start = 1; 
 			m_end = m_ts.get_size();
+			m_ts.let_accrual_rate(rate); // cached accrual factors
+			let_strike(strike);
+		}
+		
+		hedged_ptf::hedged_ptf(const std::string& name, const std::string& path,
+							   double strike, double rate, double div, std::size_t nb_threads)
+			: m_strike(strike), m_rate(rate), m_div(div), m_accuracy(accuracy::full), m_ts(name, path, nb_threads)
+		{
+			m_start = 1; 
+			m_end = m_ts.get_size();
+			m_ts.let_accrual_rate(rate);
 			let_strike(strike);
 		}
 		
@@ -30,7 +41,7 @@ namespace project
 		// destructor
 		hedged_ptf::~hedged_ptf()
 		{
-			std::cout << "Deletion of hedged_ptf object " << get_name() << std::endl;
+			PROJECT_LOG_DEBUG("Deletion of hedged_ptf object " << get_name());
 		}
 		
 		
@@ -65,8 +76,8 @@ namespace project
 		
 		double hedged_ptf::get_maturity() const
 		{
-			// maturity of the range currently used
-			return maturity(m_ts.get_date(m_end), m_ts.get_date(m_start));
+			// maturity of the range currently used (in the day-count convention of the time_series)
+			return m_ts.get_years()[m_end - 1] - m_ts.get_years()[m_start - 1];
 		}
 		
 		double hedged_ptf::get_strike() const
@@ -84,6 +95,16 @@ namespace project
 			return m_div;
 		}
 		
+		accuracy hedged_ptf::get_accuracy() const
+		{
+			return m_accuracy;
+		}
+		
+		TS::day_count hedged_ptf::get_day_count() const
+		{
+			return m_ts.get_day_count();
+		}
+		
 		
 		
 		
@@ -98,6 +119,26 @@ namespace project
 		
 		
 		
+		// access - metrics
+		ptf_metrics hedged_ptf::get_metrics() const
+		{
+			ptf_metrics metrics;
+			metrics.pnl_evaluations = m_counters.pnl_evaluations.load(std::memory_order_relaxed);
+			metrics.passes = m_counters.passes.load(std::memory_order_relaxed);
+			metrics.days = m_counters.days.load(std::memory_order_relaxed);
+			metrics.solves = m_counters.solves.load(std::memory_order_relaxed);
+			metrics.failed_solves = m_counters.failed_solves.load(std::memory_order_relaxed);
+			return metrics;
+		}
+		
+		void hedged_ptf::reset_metrics()
+		{
+			m_counters = metrics_counters();
+		}
+		
+		
+		
+		
 		// access - date range
 		std::size_t hedged_ptf::get_start() const
 		{
@@ -152,7 +193,7 @@ namespace project
 			if(strike <= 0.0)
 			{
 				// cannot set a negative strike
-				std::cout << "Error: negative strike on portfolio " << get_name() << std::endl;
+				PROJECT_LOG_ERROR("Error: negative strike on portfolio " << get_name());
 			}
 			else
 			{
@@ -165,7 +206,7 @@ namespace project
 				{
 					m_strike = strike;
 				}
-				std::cout << "Strike of portfolio " << get_name() << " set to " << m_strike << std::endl;
+				PROJECT_LOG_DEBUG("Strike of portfolio " << get_name() << " set to " << m_strike);
 				
 			}	
 		}
@@ -174,8 +215,9 @@ namespace project
 		void hedged_ptf::let_rate(double rate)
 		{
 			// no constraint as rates can actually go negative!
-			std::cout << "Rate of portfolio " << get_name() << " set to " << rate << std::endl;
+			PROJECT_LOG_DEBUG("Rate of portfolio " << get_name() << " set to " << rate);
 			m_rate = rate;
+			m_ts.let_accrual_rate(rate); // only the accruals column depends on the rate
 			// implement a more complex version, using a time_series instance of rates?
 		}
 		
@@ -184,15 +226,42 @@ namespace project
 			// dividend computations currently not implemented
 			if(div <= 0.0)
 			{
-				std::cout << "Error: negative dividends on portfolio " << get_name() << std::endl;
+				PROJECT_LOG_ERROR("Error: negative dividends on portfolio " << get_name());
 			}
 			else
 			{
-				std::cout << "Dividends of portfolio " << get_name() << " set to " << div << std::endl;
+				PROJECT_LOG_DEBUG("Dividends of portfolio " << get_name() << " set to " << div);
 				m_div = div;
 			}
 		}
 		
+		void hedged_ptf::let_accuracy(accuracy acc)
+		{
+			// a breakeven vol solved to 1e-5 does not need the normal distributions to 1e-16
+			PROJECT_LOG_DEBUG("Accuracy of portfolio " << get_name() << " set to " << (acc == accuracy::full ? "full"
+					: (acc == accuracy::high ? "high" : (acc == accuracy::fast ? "fast" : "single"))));
+			m_accuracy = acc;
+		}
+		
+		void hedged_ptf::let_day_count(TS::day_count convention)
+		{
+			PROJECT_LOG_DEBUG("Day count of portfolio " << get_name() << " set to " << (convention == TS::day_count::act_365 ? "ACT/365"
+					: (convention == TS::day_count::act_360 ? "ACT/360" : (convention == TS::day_count::act_act ? "ACT/ACT" : "BUS/252"))));
+			m_ts.let_day_count(convention); // years, periods and accruals columns
+		}
+		
+		
+		// modify - data
+		bool hedged_ptf::append(TS::day_t day, double value)
+		{
+			bool last = (m_end == m_ts.get_size());
+			if(!m_ts.append(day, value))
+				return false;
+			if(last)
+				m_end = m_ts.get_size();
+			return true;
+		}
+		
 		
 		// modify - date range
 		void hedged_ptf::let_start(std::size_t start)
@@ -200,22 +269,22 @@ namespace project
 			// if out of range
 			if((start < 1) | (start >= get_size()))
 			{
-				std::cout << "Error on portfolio " << get_name() << ": attempted let_start " << start
-						<< " is out of its possible range (" << 1 << " - " << get_size()-1 << ")" << std::endl;
+				PROJECT_LOG_ERROR("Error on portfolio " << get_name() << ": attempted let_start " << start
+						<< " is out of its possible range (" << 1 << " - " << get_size()-1 << ")");
 			}
 			else
 			{
 				// if start above current end
 				if(start >= m_end)
 				{
-					std::cout << "Error on portfolio " << get_name() << ": attempted let_start " << start
-							<< " is equal to or above end (" << m_end << ")" << std::endl;
+					PROJECT_LOG_ERROR("Error on portfolio " << get_name() << ": attempted let_start " << start
+							<< " is equal to or above end (" << m_end << ")");
 				}
 				else
 				{
 					// if all good
-					std::cout << "Start of portfolio " << get_name() << " set to " << start
-							<< " (" << TS::to_string(m_ts.get_date(start)) << ")" << std::endl;
+					PROJECT_LOG_DEBUG("Start of portfolio " << get_name() << " set to " << start
+							<< " (" << TS::to_string(m_ts.get_date(start)) << ")");
 					m_start = start; // let the new start
 				}
 			}
@@ -226,22 +295,22 @@ namespace project
 			// if out of range
 			if((end <= 1) | (end > get_size()))
 			{
-				std::cout << "Error on portfolio " << get_name() << ": attempted let_end " << end
-						<< " is out of its possible range (" << 2 << " - " << get_size() << ")" << std::endl;
+				PROJECT_LOG_ERROR("Error on portfolio " << get_name() << ": attempted let_end " << end
+						<< " is out of its possible range (" << 2 << " - " << get_size() << ")");
 			}
 			else
 			{
 				// if end below current start
 				if(end <= m_start)
 				{
-					std::cout << "Error on portfolio " << get_name() << ": attempted let_end " << end
-							<< " is equal to or below start (" << m_start << ")" << std::endl;
+					PROJECT_LOG_ERROR("Error on portfolio " << get_name() << ": attempted let_end " << end
+							<< " is equal to or below start (" << m_start << ")");
 				}
 				else
 				{
 					// if all good
-					std::cout << "End of portfolio " << get_name() << " set to " << end
-							<< " (" << TS::to_string(m_ts.get_date(end)) << ")" << std::endl;
+					PROJECT_LOG_DEBUG("End of portfolio " << get_name() << " set to " << end
+							<< " (" << TS::to_string(m_ts.get_date(end)) << ")");
 					m_end = end; // let the new end
 				}
 			}
@@ -252,13 +321,13 @@ namespace project
 			// we want a range to be at least size 2
 			if(start == end)
 			{
-				std::cout << "Error on portfolio " << get_name() << ": attempted let_range " << start 
-						<< " - " << end << " has equal values" << std::endl;
+				PROJECT_LOG_ERROR("Error on portfolio " << get_name() << ": attempted let_range " << start 
+						<< " - " << end << " has equal values");
 			}
 			else if(start > end) // avoid crossing range
 			{
-				std::cout << "Error on portfolio " << get_name() << ": attempted let_range " << start 
-						<< " - " << end << " is crossing" << std::endl;
+				PROJECT_LOG_ERROR("Error on portfolio " << get_name() << ": attempted let_range " << start 
+						<< " - " << end << " is crossing");
 			}
 			else
 			{
@@ -280,11 +349,62 @@ namespace project
 		// sets range to last n months (for vol computations)
 		void hedged_ptf::let_last_range(std::size_t n, bool next)
 		{
-			// need static cast to transform std::size_t into int to avoid warnings
-			let_start(m_ts.shift_months(m_ts.get_size(), static_cast<int>(n), false));
+			let_start(get_last_start(n, next));
 			let_end(m_ts.get_size());
 		}
 		
+		// start of the last n months range (without modifying the portfolio)
+		std::size_t hedged_ptf::get_last_start(std::size_t n, bool next) const
+		{
+			// need static cast to transform std::size_t into int to avoid warnings
+			return m_ts.shift_months(m_ts.get_size(), static_cast<int>(n), false, next);
+		}
+		
+		
+		
+		
+		// metrics counters (relaxed atomics: only the totals matter, several threads can count at the same time)
+		hedged_ptf::metrics_counters::metrics_counters()
+			: pnl_evaluations(0), passes(0), days(0), solves(0), failed_solves(0)
+		{
+		}
+		
+		hedged_ptf::metrics_counters::metrics_counters(const metrics_counters& other)
+			: pnl_evaluations(other.pnl_evaluations.load(std::memory_order_relaxed)),
+			  passes(other.passes.load(std::memory_order_relaxed)),
+			  days(other.days.load(std::memory_order_relaxed)),
+			  solves(other.solves.load(std::memory_order_relaxed)),
+			  failed_solves(other.failed_solves.load(std::memory_order_relaxed))
+		{
+		}
+		
+		hedged_ptf::metrics_counters& hedged_ptf::metrics_counters::operator=(const metrics_counters& other)
+		{
+			pnl_evaluations.store(other.pnl_evaluations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			passes.store(other.passes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			days.store(other.days.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			solves.store(other.solves.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			failed_solves.store(other.failed_solves.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			return *this;
+		}
+		
+		// one pass over a range of size days, evaluating the pnl of n options
+		void hedged_ptf::count_pass(std::size_t n, std::size_t size) const
+		{
+			m_counters.pnl_evaluations.fetch_add(n, std::memory_order_relaxed);
+			m_counters.passes.fetch_add(1, std::memory_order_relaxed);
+			m_counters.days.fetch_add(size, std::memory_order_relaxed);
+		}
+		
+		// one implied vol solve
+		const solver_result& hedged_ptf::count_solve(const solver_result& result) const
+		{
+			m_counters.solves.fetch_add(1, std::memory_order_relaxed);
+			if(!result.converged)
+				m_counters.failed_solves.fetch_add(1, std::memory_order_relaxed);
+			return result;
+		}
+		
 		
 		
 		
@@ -294,124 +414,644 @@ namespace project
 		
 		
 		// P&L computations
+		// the versions without range and strike use the current ones of the portfolio
+		// the other versions do not depend on the current range and strike, so they can run in parallel
+		// the loops are sweeps on the cached columns of m_ts (prices, year fractions, returns and accruals)
+		// the pointers are shifted so that index 0 is the start of the range
 		double hedged_ptf::get_pnl(double vol, bool call) const
+		{
+			return get_pnl(m_start, m_end, m_strike, vol, call);
+		}
+		
+		double hedged_ptf::get_pnl(std::size_t start, std::size_t end, double strike, double vol, bool call) const
+		{
+			return get_pnl(hedge_schedule(*this, start, end), strike, vol, call);
+		}
+		
+		double hedged_ptf::get_pnl(const hedge_schedule& schedule, double strike, double vol, bool call) const
 		{
 			// This method computes the pnl of an autofinancing portfolio
 			// that delta-hedges daily the option, and invest the rest in the risk free rate
+			return (this->*select_pnl(pnl_method::self_financing, call, schedule.get_rate() == 0.0, m_accuracy))(schedule, strike, vol);
+		}
+		
+		
+		double hedged_ptf::get_delta_pnl(double vol, bool call) const
+		{
+			return get_delta_pnl(m_start, m_end, m_strike, vol, call);
+		}
+		
+		double hedged_ptf::get_delta_pnl(std::size_t start, std::size_t end, double strike, double vol, bool call) const
+		{
+			return get_delta_pnl(hedge_schedule(*this, start, end), strike, vol, call);
+		}
+		
+		double hedged_ptf::get_delta_pnl(const hedge_schedule& schedule, double strike, double vol, bool call) const
+		{
+			// This method does not take into account the interest of risk-free position
+			// if rates = 0, this yields the same computations as the normal get_pnl method.
+			// otherwise, it is not appropriate for computing breakeven volatility
+			// as it returns strictly positive pnl under some circumstances
+			// (due to ommitting the positive rates)
+			return (this->*select_pnl(pnl_method::delta_only, call, schedule.get_rate() == 0.0, m_accuracy))(schedule, strike, vol);
+		}
+		
+		
+		double hedged_ptf::get_robust_pnl(double vol, bool call) const
+		{
+			return get_robust_pnl(m_start, m_end, m_strike, vol, call);
+		}
+		
+		double hedged_ptf::get_robust_pnl(std::size_t start, std::size_t end, double strike, double vol, bool call) const
+		{
+			return get_robust_pnl(hedge_schedule(*this, start, end), strike, vol, call);
+		}
+		
+		double hedged_ptf::get_robust_pnl(const hedge_schedule& schedule, double strike, double vol, bool call) const
+		{
+			// computing the pnl using the gamma weighted average method
+			// This method yields similar results to the get_pnl
+			// However a significant difference can be observed on strikes where the option ends
+			// close to at the money, because of the high gamma effect near maturity
+			// (the gamma is the same for calls and puts)
+			return (this->*select_pnl(pnl_method::gamma_weighted, call, schedule.get_rate() == 0.0, m_accuracy))(schedule, strike, vol);
+		}
+		
+		
+		namespace
+		{
+			// policies of the hedging engine (see hedged_ptf::hedge)
+			// side of the option: the deltas are computed for calls, the put deltas by call-put parity
+			// delta(): hedge of a line from get_deltas, the delta itself in double, rebuilt from the signed tail in float
+			struct call_side
+			{
+				static constexpr bool call = true;
+				static double payoff(double spot, double strike)
+				{
+					return std::max(spot - strike, 0.0);
+				}
+				static double delta(double delta)
+				{
+					return delta;
+				}
+				static double delta(float tail)
+				{
+					return (tail < 0.0f) ? 1.0 + tail : static_cast<double>(tail);
+				}
+			};
 			
-			// time to maturity
-			double mat = get_maturity();
+			struct put_side
+			{
+				static constexpr bool call = false;
+				static double payoff(double spot, double strike)
+				{
+					return std::max(strike - spot, 0.0);
+				}
+				static double delta(double delta)
+				{
+					return delta;
+				}
+				static double delta(float tail)
+				{
+					return (tail < 0.0f) ? static_cast<double>(tail) : tail - 1.0;
+				}
+			};
 			
-			// portfolio
-			double value = price_bs(get_spot(), m_strike, mat, m_rate, vol, call);
-			double inv_stock = delta_bs(get_spot(), m_strike, mat, m_rate, vol, call); // delta
-			double inv_rate = value - get_spot() * inv_stock; // risk-free rate investment
+			// pnl methods (see pnl_method)
+			struct self_financing_pnl
+			{
+				static constexpr bool gamma = false;
+				static constexpr bool cash = true; // interests of the risk-free position
+			};
 			
-			// loop on the range
-			for(std::size_t i = 1; i < get_size_range(); ++i)
+			struct delta_only_pnl
+			{
+				static constexpr bool gamma = false;
+				static constexpr bool cash = false;
+			};
+			
+			struct gamma_weighted_pnl
+			{
+				static constexpr bool gamma = true;
+				static constexpr bool cash = false;
+			};
+			
+			// rate regimes: with a zero rate the accruals are 0, the cash is not carried
+			struct no_rate
+			{
+				static constexpr bool zero = true;
+			};
+			
+			struct with_rate
+			{
+				static constexpr bool zero = false;
+			};
+			
+			// normal distributions in the scalar type of the engine (float: accuracy::single)
+			void normal_cdfs(std::size_t n, double* x, accuracy acc)
+			{
+				batch_normal_cdf(n, x, x, acc);
+			}
+			
+			void normal_cdfs(std::size_t n, float* x, accuracy)
+			{
+				batch_normal_cdf(n, x, x);
+			}
+			
+			void normal_pdfs(std::size_t n, double* x, accuracy acc)
+			{
+				batch_normal_pdf(n, x, x, acc);
+			}
+			
+			void normal_pdfs(std::size_t n, float* x, accuracy)
+			{
+				batch_normal_pdf(n, x, x);
+			}
+			
+			// scratch arrays of the pnl computations, one set per thread (the ranges are hedged from the threads of
+			// the pool): grown to the largest range or number of options seen, then reused by every evaluation, so the
+			// solvers do not allocate at each iteration. A slot is used by one array of a computation at a time.
+			enum scratch_slot
+			{
+				slot_greeks, // deltas or densities of the range (hedge), values of the options (get_pnls)
+				slot_d1, // d1 of the range in float (get_deltas<float>)
+				slot_deltas,
+				slot_stocks,
+				slot_cash,
+				slot_puts,
+				nb_slots
+			};
+			
+			template<typename Scalar>
+			Scalar* scratch(scratch_slot slot, std::size_t size)
+			{
+				static thread_local std::vector<Scalar> buffers[nb_slots];
+				std::vector<Scalar>& buffer = buffers[slot];
+				if(buffer.size() < size)
+					buffer.resize(size);
+				return buffer.data();
+			}
+			
+			// number of lines on which the hedge is updated: the maturity is 0 only on the last lines (the day of
+			// the end of the range), where the delta is kept, so the loops need no test on the maturity
+			std::size_t hedge_days(const double* mat, std::size_t size)
+			{
+				while((size > 1) && (mat[size - 1] == 0))
+					--size;
+				return size;
+			}
+		}
+		
+		
+		// d1 of the whole range: the log-moneyness, maturities and their square roots come from the schedule
+		// d1 = (log(S / K) + T * (r + vol^2 / 2)) / (vol * sqrt(T)), with log(S / K) = log(S / S0) + log(S0 / K)
+		// computed in double, stored in the scalar type of the normal distributions
+		template<typename Scalar>
+		void hedged_ptf::get_d1(const hedge_schedule& schedule, double strike, double vol, Scalar* d1) const
+		{
+			const double* log_moneyness = schedule.get_log_moneyness().data();
+			const double* mat = schedule.get_maturities().data();
+			const double* sqrt_mat = schedule.get_sqrt_maturities().data();
+			std::size_t size = schedule.get_size();
+			
+			double log_strike = std::log(schedule.get_spots()[0] / strike);
+			double drift = schedule.get_rate() + 0.5 * vol * vol;
+			for(std::size_t i = 0; i < size; ++i)
+				d1[i] = static_cast<Scalar>((log_moneyness[i] + log_strike + mat[i] * drift) / (vol * sqrt_mat[i]));
+		}
+		
+		// deltas of the whole range (put delta = call delta - 1, exactly as batch_bs does)
+		template<typename Scalar>
+		void hedged_ptf::get_deltas(const hedge_schedule& schedule, double strike, double vol, bool call, Scalar* delta) const
+		{
+			std::size_t size = schedule.get_size();
+			get_d1(schedule, strike, vol, delta);
+			normal_cdfs(size, delta, m_accuracy);
+			if(!call)
+				for(std::size_t i = 0; i < size; ++i)
+					delta[i] -= 1;
+		}
+		
+		
+		// single precision: N(d1) close to 1 is rounded to 1 in float (a delta of 1 - 1e-10 is 1), so the tail
+		// N(-|d1|) is stored instead, with the sign of -d1, and the side rebuilds the delta in double (see call_side)
+		template<>
+		void hedged_ptf::get_deltas(const hedge_schedule& schedule, double strike, double vol, bool, float* tail) const
+		{
+			std::size_t size = schedule.get_size();
+			float* d1 = scratch<float>(slot_d1, size);
+			get_d1(schedule, strike, vol, d1);
+			for(std::size_t i = 0; i < size; ++i)
+				tail[i] = -std::fabs(d1[i]);
+			normal_cdfs(size, tail, m_accuracy);
+			for(std::size_t i = 0; i < size; ++i)
+				tail[i] = (d1[i] > 0.0f) ? -tail[i] : tail[i];
+		}
+		
+		
+		// hedging engine: the side, the method and the rate regime are template parameters, so each of the
+		// instantiations is a straight loop on the range, without any of the branches of a generic version
+		// same operations as the generic loops (up to the multiply-adds the compiler fuses, ~1e-13 on the pnl)
+		// the deltas and densities are in Scalar (float: twice the lanes, half the memory), the pnl is summed in double
+		template<class Side, class Method, class Rate, typename Scalar>
+		double hedged_ptf::hedge(const hedge_schedule& schedule, double strike, double vol) const
+		{
+			const double* spot = schedule.get_spots().data();
+			const double* mat = schedule.get_maturities().data();
+			const double* accruals = schedule.get_accruals().data();
+			double rate = Rate::zero ? 0.0 : schedule.get_rate();
+			std::size_t size = schedule.get_size();
+			std::size_t days = hedge_days(mat, size);
+			count_pass(1, size);
+			
+			if(Method::gamma)
 			{
-				// compute current maturity 
-				mat = maturity(m_ts.get_date(m_end), m_ts.get_date(m_start + i));
+				const double* factors = schedule.get_gamma_factors().data();
+				const double* dollar_variances = schedule.get_dollar_variances().data();
+				const double* dollar_times = schedule.get_dollar_times().data();
 				
-				// change in portfolio value = change in delta + change in risk-free cash
-				value += inv_stock * (m_ts[m_start + i] - m_ts[m_start + i - 1])
-					   + inv_rate * (std::exp(m_rate * maturity(m_ts.get_date(m_start + i), m_ts.get_date(m_start + i - 1))) - 1.0);
+				// normal densities at d1 of the whole range in one batch (gamma = pdf(d1) / vol * factor)
+				Scalar* pdf = scratch<Scalar>(slot_greeks, size);
+				get_d1(schedule, strike, vol, pdf);
+				normal_pdfs(size, pdf, m_accuracy);
 				
-				// new delta 
-				if(mat != 0)
-					inv_stock = delta_bs(m_ts[m_start + i], m_strike, mat, m_rate, vol, call);
+				// sum of dollar gamma times realized vol squared minus implied vol squared
+				// gamma(i) * S(i)^2 * ((dS(i) / S(i))^2 - vol^2 * dt(i, i+1)) with dS(i) = S(i+1) - S(i)
+				// the gamma of the previous day is defined on the hedged lines (see hedge_days)
+				double var = vol * vol;
+				double pnl = 0;
+				for(std::size_t i = 1; i < days; ++i)
+					pnl += pdf[i - 1] * factors[i - 1] * (dollar_variances[i] - var * dollar_times[i]);
 				
-				// the rest is invested in the risk-free asset
-				inv_rate = value - m_ts[m_start + i] * inv_stock;
+				// last lines: the gamma of the last hedged line is kept (infinite factor at maturity 0)
+				double gamma = (mat[days - 1] != 0) ? pdf[days - 1] * factors[days - 1] : 0.0;
+				for(std::size_t i = days; i < size; ++i)
+					pnl += gamma * (dollar_variances[i] - var * dollar_times[i]);
 				
-				// print for debugging
-				// std::cout << mat << ' ' << m_ts[m_start + i] << ' ' << inv_stock << ' ' << inv_rate << ' ' << value << std::endl;
+				// return negative pnl as we want the function to be generally increasing with vol (for our dichotomy)
+				return -pnl / vol * 0.5;
+			}
+			
+			// deltas of the whole range in one batch
+			Scalar* delta = scratch<Scalar>(slot_greeks, size);
+			get_deltas(schedule, strike, vol, Side::call, delta);
+			
+			// portfolio: Black-Scholes price at the start
+			double value = price_bs(spot[0], strike, mat[0], rate, vol, Side::call);
+			double inv_stock = Side::delta(delta[0]); // delta
+			double inv_rate = value - spot[0] * inv_stock; // risk-free rate investment
+			
+			// change in portfolio value = change in delta + change in risk-free cash (none with a zero rate)
+			auto carry = [&](std::size_t i)
+			{
+				if(Method::cash && !Rate::zero)
+					value += inv_stock * (spot[i] - spot[i - 1]) + inv_rate * accruals[i];
+				else
+					value += inv_stock * (spot[i] - spot[i - 1]);
+			};
+			
+			// loop on the range: new delta, the rest is invested in the risk-free asset
+			for(std::size_t i = 1; i < days; ++i)
+			{
+				carry(i);
+				inv_stock = Side::delta(delta[i]);
+				inv_rate = value - spot[i] * inv_stock;
 			}
 			
-			double payoff = call ? std::max((m_ts[m_end] - m_strike), 0.0) : std::max((m_strike - m_ts[m_end]), 0.0);
-			// std::cout << "final payoff: " << payoff << std::endl;
-			return value - payoff;
+			// last lines: the delta is kept
+			for(std::size_t i = days; i < size; ++i)
+			{
+				carry(i);
+				inv_rate = value - spot[i] * inv_stock;
+			}
+			
+			return value - Side::payoff(spot[size - 1], strike);
 		}
 		
+		// one instantiation per combination (the gamma is the same for calls and puts, the delta-only pnl does
+		// not use the cash, the rate only enters its initial price and its deltas)
+		hedged_ptf::pnl_kernel hedged_ptf::select_pnl(pnl_method method, bool call, bool zero_rate, accuracy acc)
+		{
+			if(acc == accuracy::single)
+				return select_kernel<float>(method, call, zero_rate);
+			return select_kernel<double>(method, call, zero_rate);
+		}
 		
-		double hedged_ptf::get_delta_pnl(double vol, bool call) const
+		template<typename Scalar>
+		hedged_ptf::pnl_kernel hedged_ptf::select_kernel(pnl_method method, bool call, bool zero_rate)
 		{
-			// This method does not take into account the interest of risk-free position
-			// if rates = 0, this yields the same computations as the normal get_pnl method.
-			// otherwise, it is not appropriate for computing breakeven volatility
-			// as it returns strictly positive pnl under some circumstances
-			// (due to ommitting the positive rates)
+			switch(method)
+			{
+				case pnl_method::gamma_weighted:
+					return zero_rate ? &hedged_ptf::hedge<call_side, gamma_weighted_pnl, no_rate, Scalar>
+									 : &hedged_ptf::hedge<call_side, gamma_weighted_pnl, with_rate, Scalar>;
+				case pnl_method::delta_only:
+					return call ? &hedged_ptf::hedge<call_side, delta_only_pnl, with_rate, Scalar>
+								: &hedged_ptf::hedge<put_side, delta_only_pnl, with_rate, Scalar>;
+				default:
+					if(zero_rate)
+						return call ? &hedged_ptf::hedge<call_side, self_financing_pnl, no_rate, Scalar>
+									: &hedged_ptf::hedge<put_side, self_financing_pnl, no_rate, Scalar>;
+					return call ? &hedged_ptf::hedge<call_side, self_financing_pnl, with_rate, Scalar>
+								: &hedged_ptf::hedge<put_side, self_financing_pnl, with_rate, Scalar>;
+			}
+		}
+		
+		
+		
+		// P&L computations for several (strike, vol) options
+		// same computations as get_pnl and get_robust_pnl, the loop on the options is inside the loop on the range:
+		// the prices, year fractions and accruals are loaded once per day for all the options, and the inner loops
+		// (one lane per option, portfolios stored as one array per quantity) are vectorized
+		void hedged_ptf::get_pnls(std::size_t start, std::size_t end, double strike, const double* vols, std::size_t n,
+								  double* pnls, bool call) const
+		{
+			std::vector<double> strikes(n, strike);
+			std::unique_ptr<bool[]> calls(new bool[n]);
+			std::fill(calls.get(), calls.get() + n, call);
+			get_pnls(hedge_schedule(*this, start, end), strikes.data(), vols, calls.get(), n, pnls);
+		}
+		
+		void hedged_ptf::get_pnls(std::size_t start, std::size_t end, const double* strikes, const double* vols,
+								  const bool* calls, std::size_t n, double* pnls) const
+		{
+			get_pnls(hedge_schedule(*this, start, end), strikes, vols, calls, n, pnls);
+		}
+		
+		void hedged_ptf::get_pnls(const hedge_schedule& schedule, const double* strikes, const double* vols,
+								  const bool* calls, std::size_t n, double* pnls) const
+		{
+			const double* spot = schedule.get_spots().data();
+			const double* maturities = schedule.get_maturities().data();
+			const double* accruals = schedule.get_accruals().data();
+			double rate = schedule.get_rate();
+			std::size_t size = schedule.get_size();
+			count_pass(n, size);
+			
+			// the greeks are computed for calls, puts are deduced by call-put parity
+			// (put delta = call delta - 1, exactly as batch_bs does)
+			double* put = scratch<double>(slot_puts, n);
+			for(std::size_t j = 0; j < n; ++j)
+				put[j] = calls[j] ? 0.0 : 1.0;
 			
-			// time to maturity
-			double mat = get_maturity();
+			// portfolios (scratch arrays of the thread, see scratch)
+			double* value = scratch<double>(slot_greeks, n);
+			double* delta = scratch<double>(slot_deltas, n);
+			double* inv_stock = scratch<double>(slot_stocks, n);
+			double* inv_rate = scratch<double>(slot_cash, n);
+			double disc = schedule.get_discounts()[0];
+			bs_outputs outputs;
+			outputs.price = value;
+			outputs.delta = delta;
+			batch_bs(n, spot[0], strikes, maturities[0], rate, vols, outputs, true, m_accuracy);
+			for(std::size_t j = 0; j < n; ++j)
+			{
+				value[j] -= put[j] * (spot[0] - strikes[j] * disc);
+				inv_stock[j] = delta[j] - put[j];
+				inv_rate[j] = value[j] - spot[0] * inv_stock[j];
+			}
 			
-			// portfolio
-			double value = price_bs(get_spot(), m_strike, mat, m_rate, vol, call);
-			double inv_stock = delta_bs(get_spot(), m_strike, mat, m_rate, vol, call); // delta
+			// only the deltas are updated in the loop
+			outputs.price = nullptr;
 			
 			// loop on the range
-			for(std::size_t i = 1; i < get_size_range(); ++i)
+			for(std::size_t i = 1; i < size; ++i)
 			{
-				// compute current maturity 
-				mat = maturity(m_ts.get_date(m_end), m_ts.get_date(m_start + i));
+				double mat = maturities[i];
+				double ds = spot[i] - spot[i - 1];
+				double accrual = accruals[i];
+				
+				// change in portfolio value = change in delta + change in risk-free cash
+				for(std::size_t j = 0; j < n; ++j)
+					value[j] += inv_stock[j] * ds + inv_rate[j] * accrual;
 				
-				// pnl from delta hedging (no consideration of cash)
-				value += inv_stock * (m_ts[m_start + i] - m_ts[m_start + i - 1]);
-					   
-				// new delta 
+				// new deltas
 				if(mat != 0)
-					inv_stock = delta_bs(m_ts[m_start + i], m_strike, mat, m_rate, vol, call);
+				{
+					batch_bs(n, spot[i], strikes, mat, rate, vols, outputs, true, m_accuracy);
+					for(std::size_t j = 0; j < n; ++j)
+						inv_stock[j] = delta[j] - put[j];
+				}
 				
+				// the rest is invested in the risk-free asset
+				for(std::size_t j = 0; j < n; ++j)
+					inv_rate[j] = value[j] - spot[i] * inv_stock[j];
 			}
 			
-			double payoff = call ? std::max((m_ts[m_end] - m_strike), 0.0) : std::max((m_strike - m_ts[m_end]), 0.0);
-			return value - payoff;
+			for(std::size_t j = 0; j < n; ++j)
+			{
+				double payoff = calls[j] ? std::max((spot[size - 1] - strikes[j]), 0.0) : std::max((strikes[j] - spot[size - 1]), 0.0);
+				pnls[j] = value[j] - payoff;
+			}
 		}
 		
+		void hedged_ptf::get_robust_pnls(std::size_t start, std::size_t end, double strike, const double* vols, std::size_t n,
+										 double* pnls, bool) const
+		{
+			// the gamma is the same for calls and puts (the side is only kept for the symmetry with get_pnls)
+			std::vector<double> strikes(n, strike);
+			get_robust_pnls(hedge_schedule(*this, start, end), strikes.data(), vols, n, pnls);
+		}
 		
-		double hedged_ptf::get_robust_pnl(double vol, bool call) const
+		void hedged_ptf::get_robust_pnls(std::size_t start, std::size_t end, const double* strikes, const double* vols,
+										 std::size_t n, double* pnls) const
 		{
-			// computing the pnl using the gamma weighted average method
-			// This method yields similar results to the get_pnl
-			// However a significant difference can be observed on strikes where the option ends
-			// close to at the money, because of the high gamma effect near maturity
-			
-			
-			// time to maturity
-			double mat = get_maturity();
-			double dt, ds; // delta time, delta stock
+			get_robust_pnls(hedge_schedule(*this, start, end), strikes, vols, n, pnls);
+		}
+		
+		void hedged_ptf::get_robust_pnls(const hedge_schedule& schedule, const double* strikes, const double* vols,
+										 std::size_t n, double* pnls) const
+		{
+			const double* spot = schedule.get_spots().data();
+			const double* maturities = schedule.get_maturities().data();
+			const double* dollar_variances = schedule.get_dollar_variances().data();
+			const double* dollar_times = schedule.get_dollar_times().data();
+			double rate = schedule.get_rate();
+			std::size_t size = schedule.get_size();
+			count_pass(n, size);
 			
-			// portfolio
-			double pnl = 0;
-			double gamma = gamma_bs(get_spot(), m_strike, mat, m_rate, vol, call);
+			// implied variances and gammas
+			double* var = scratch<double>(slot_cash, n);
+			double* gamma = scratch<double>(slot_greeks, n);
+			for(std::size_t j = 0; j < n; ++j)
+			{
+				var[j] = vols[j] * vols[j];
+				pnls[j] = 0.0;
+			}
+			bs_outputs outputs;
+			outputs.gamma = gamma;
+			batch_bs(n, spot[0], strikes, maturities[0], rate, vols, outputs, true, m_accuracy);
 			
 			// loop on the range
-			for(std::size_t i = 1; i < get_size_range(); ++i)
+			for(std::size_t i = 1; i < size; ++i)
 			{
-				// computations
-				mat = maturity(m_ts.get_date(m_end), m_ts.get_date(m_start + i)); // for gamma 
-				dt = maturity(m_ts.get_date(m_start + i), m_ts.get_date(m_start + i - 1)); // times vol square
-				ds = (m_ts[m_start + i] - m_ts[m_start + i - 1]) / m_ts[m_start + i - 1]; // to square
+				double mat = maturities[i];
+				double dollar_variance = dollar_variances[i];
+				double dollar_time = dollar_times[i];
 				
-				// change in pnl
-				// sum of dollar gamma times realized vol squared minus implied vol squared
-				// gamma(i) * S(i)^2 * ((dS(i) / S(i))^2 - vol^2 * dt(i, i+1)) with dS(i) = S(i+1) - S(i)
-				pnl += gamma * m_ts[m_start + i - 1] * m_ts[m_start + i - 1] * (ds * ds - vol * vol * dt);
+				// dollar gamma times realized variance minus implied variance
+				for(std::size_t j = 0; j < n; ++j)
+					pnls[j] += gamma[j] * (dollar_variance - var[j] * dollar_time);
 				
-				// new gamma 
+				// new gammas
 				if(mat != 0)
-					gamma = gamma_bs(m_ts[m_start + i], m_strike, mat, m_rate, vol, call);
-				
+					batch_bs(n, spot[i], strikes, mat, rate, vols, outputs, true, m_accuracy);
 			}
 			
-			// return negative pnl as we want the function to be generally increasing with vol (for our dichotomy)
-			return -pnl * 0.5;
+			// negative pnl as in get_robust_pnl
+			for(std::size_t j = 0; j < n; ++j)
+				pnls[j] *= -0.5;
 		}
 		
 		
 		
+		namespace
+		{
+			// standardized pnl minus the tolerance (standardize pnl because pnl is proportional to spot)
+			// the pnl method depends on the boolean parameter robust_pnl, each evaluation is counted in result
+			// the specialized pnl computation is selected once per solve (see hedged_ptf::select_pnl)
+			class pnl_residual
+			{
+			public:
+				
+				pnl_residual(const hedged_ptf& ptf, const hedge_schedule& schedule, double strike, bool robust_pnl,
+							 double tol, solver_result& result)
+					: m_ptf(ptf), m_schedule(schedule), m_strike(strike), m_tol(tol),
+					  m_spot(schedule.get_spots().front()), m_result(result)
+				{
+					// optimization depending on the moneyness (hedging using call or put)
+					// in theory it should not change the result for the delta method (and it doesn't when rates are equal to zero)
+					// but in practice, it does change marginally because of the discounting effect
+					// the results are equal for the gamma method, as gamma is the same for puts and calls
+					bool call = (schedule.get_spots().back() - strike > 0.0) ? true : false;
+					m_pnl = hedged_ptf::select_pnl(robust_pnl ? pnl_method::gamma_weighted : pnl_method::self_financing,
+												   call, schedule.get_rate() == 0.0, ptf.get_accuracy());
+				}
+				
+				double operator()(double vol)
+				{
+					++m_result.iterations;
+					++m_result.sweeps;
+					double pnl = (m_ptf.*m_pnl)(m_schedule, m_strike, vol);
+					double res = pnl / m_spot - m_tol;
+					return (res == res) ? res : -m_tol; // a NaN pnl is treated as a zero pnl (as in the dichotomy)
+				}
+				
+			private:
+				
+				const hedged_ptf& m_ptf;
+				const hedge_schedule& m_schedule;
+				double m_strike;
+				double m_tol;
+				double m_spot;
+				hedged_ptf::pnl_kernel m_pnl;
+				solver_result& m_result;
+			};
+			
+			
+			// Chandrupatla's iterations inside the bracket [a, b] where the residual changes sign (see solve_implied_vol)
+			void chandrupatla(pnl_residual& residual, double a, double fa, double b, double fb, stop_criterion stop,
+							  double precision, double residual_precision, solver_result& result)
+			{
+				// a is the last point, b the other side of the bracket, c the point before
+				double c = a, fc = fa;
+				double t = 0.5; // next point: a + t * (b - a)
+				const double eps = std::numeric_limits<double>::epsilon();
+				const std::size_t max_iter = 100; // the dichotomy would need ~log2((v_high - v_low) / precision)
+				
+				while(result.iterations < max_iter)
+				{
+					// new point, the bracket is updated to keep the change of sign
+					double x = a + t * (b - a);
+					double fx = residual(x);
+					if((fx > 0.0) == (fa > 0.0))
+					{
+						c = a;
+						fc = fa;
+					}
+					else
+					{
+						c = b;
+						fc = fb;
+						b = a;
+						fb = fa;
+					}
+					a = x;
+					fa = fx;
+					
+					// best estimate
+					double x_best = (std::abs(fa) < std::abs(fb)) ? a : b;
+					double f_best = (std::abs(fa) < std::abs(fb)) ? fa : fb;
+					
+					// stopping criteria
+					double tol1 = 2.0 * eps * std::abs(x_best) + 0.25 * precision; // |x_best - root| < precision / 2, as the dichotomy
+					double t_lim = tol1 / std::abs(b - c);
+					bool bracket_ok = (t_lim > 0.5) || (f_best == 0.0);
+					bool residual_ok = std::abs(f_best) <= residual_precision;
+					if(   ((stop == stop_criterion::bracket) & bracket_ok)
+					   || ((stop == stop_criterion::residual) & (residual_ok | (f_best == 0.0)))
+					   || ((stop == stop_criterion::either) & (bracket_ok | residual_ok)))
+					{
+						result.vol = x_best;
+						result.residual = f_best;
+						result.converged = true;
+						return;
+					}
+					
+					// inverse quadratic interpolation if the three points are well-behaved, bisection otherwise
+					double xi = (a - b) / (c - b);
+					double phi = (fa - fb) / (fc - fb);
+					if((phi * phi < xi) & ((1.0 - phi) * (1.0 - phi) < 1.0 - xi))
+					{
+						t = fa / (fb - fa) * fc / (fb - fc) + (c - a) / (b - a) * fa / (fc - fa) * fb / (fc - fb);
+					}
+					else
+					{
+						t = 0.5;
+					}
+					// at least tol1 away from the bracket
+					t_lim = std::min(t_lim, 0.5);
+					t = std::min(std::max(t, t_lim), 1.0 - t_lim);
+				}
+				
+				// did not converge
+				result.vol = a;
+				result.residual = fa;
+			}
+		}
+		
+		
 		// implied vol computations
 		double hedged_ptf::get_implied_vol(bool robust_pnl, double tol, double precision, double v_low, double v_high) const
+		{
+			return get_implied_vol(m_start, m_end, m_strike, robust_pnl, tol, precision, v_low, v_high);
+		}
+		
+		double hedged_ptf::get_implied_vol(std::size_t start, std::size_t end, double strike, bool robust_pnl,
+										   double tol, double precision, double v_low, double v_high) const
+		{
+			solver_result result = solve_implied_vol(start, end, strike, robust_pnl, stop_criterion::bracket,
+													 tol, precision, v_low, v_high);
+			if(!result.converged)
+			{
+				PROJECT_LOG_WARNING("Solver for implied vol did not converge in " << result.iterations << " iterations");
+				return 0;
+			}
+			return result.vol;
+		}
+		
+		
+		solver_result hedged_ptf::solve_implied_vol(std::size_t start, std::size_t end, double strike, bool robust_pnl,
+													stop_criterion stop, double tol, double precision, double v_low, double v_high,
+													double residual_precision) const
+		{
+			return solve_implied_vol(hedge_schedule(*this, start, end), strike, robust_pnl, stop, tol, precision,
+									 v_low, v_high, residual_precision);
+		}
+		
+		solver_result hedged_ptf::solve_implied_vol(const hedge_schedule& schedule, double strike, bool robust_pnl,
+													stop_criterion stop, double tol, double precision, double v_low, double v_high,
+													double residual_precision) const
 		{
 			// In this method we assume that the pnl is in general increasing with implied-volatility (using get_pnl).
 			// By analyzing pnl for different implied volatility at lower strike, we found that 
@@ -421,49 +1061,365 @@ namespace project
 			// We want to create a method that allows to find the implied-vol 
 			// that gives a pnl equal to the tolerance (which has to be very low, 1e-13 for example)
 			
+			// Chandrupatla's method (a variant of Brent's method): inverse quadratic interpolation inside a bracket
+			// where the standardized pnl minus the tolerance changes sign, only when the last three points show
+			// the function is locally well-behaved, bisection otherwise. Like the dichotomy, it can not leave the
+			// bracket so it stays robust to the non-monotone pnl. Near the money it needs ~8 pnl evaluations instead
+			// of ~18. Far from the money, the root is where the pnl leaves its numerical noise floor (~1e-15): the
+			// pnl is flat below it, so the steps are mostly bisections there.
 			
-			// optimization depending on the moneyness (hedging using call or put)
-			// in theory it should not change the result for the delta method (and it doesn't when rates are equal to zero)
-			// but in practice, it does change marginally because of the discounting effect
-			// the results are equal for the gamma method, as gamma is the same for puts and calls
-			bool call = (m_ts[m_end] - m_strike > 0.0) ? true : false;
+			solver_result result = {0.0, 0, 0, 0.0, false};
+			pnl_residual residual(*this, schedule, strike, robust_pnl, tol, result);
 			
-			// initialization (midpoint)
-			double vol = (v_low + v_high) / 2.0;
+			// bounds: a zero vol is replaced by a tiny one (degenerate greeks)
+			double a = std::max(v_low, 0.5 * precision), b = v_high;
+			double fa = residual(a), fb = residual(b);
+			
+			// no change of sign: same answer as the dichotomy, the bound towards which it converges
+			if((fa > 0.0) == (fb > 0.0))
+			{
+				result.vol = (fa > 0.0) ? a : b;
+				result.residual = (fa > 0.0) ? fa : fb;
+				result.converged = true;
+				return count_solve(result);
+			}
 			
-			// the pnl method depends on the boolean parameter robust_pnl
-			double pnl = robust_pnl ? get_robust_pnl(vol, call) : get_pnl(vol, call);
+			chandrupatla(residual, a, fa, b, fb, stop, precision, residual_precision, result);
+			return count_solve(result);
+		}
+		
+		
+		solver_result hedged_ptf::solve_implied_vol_from(std::size_t start, std::size_t end, double strike, double guess,
+														 bool robust_pnl, double width, stop_criterion stop, double tol,
+														 double precision, double v_low, double v_high,
+														 double residual_precision) const
+		{
+			return solve_implied_vol_from(hedge_schedule(*this, start, end), strike, guess, robust_pnl, width, stop, tol,
+										  precision, v_low, v_high, residual_precision);
+		}
+		
+		solver_result hedged_ptf::solve_implied_vol_from(const hedge_schedule& schedule, double strike, double guess,
+														 bool robust_pnl, double width, stop_criterion stop, double tol,
+														 double precision, double v_low, double v_high,
+														 double residual_precision) const
+		{
+			// Warm start (eg. from the vol of the previous day): the bracket [guess - width, guess + width] is
+			// moved and widened (doubling its width) towards the change of sign, until it finds it or reaches
+			// the bounds, then the same iterations as solve_implied_vol. When the vol moved by less than width,
+			// it saves the ~log2(1 / width) first bisections of the cold solver.
+			// With a non-monotone pnl, the change of sign found is the closest to the guess.
 			
-			// managing the number of iterations
-			std::size_t count = 0, max_iter = static_cast<int>(10 / precision); 
+			solver_result result = {0.0, 0, 0, 0.0, false};
+			pnl_residual residual(*this, schedule, strike, robust_pnl, tol, result);
 			
+			double lower = std::max(v_low, 0.5 * precision);
+			guess = std::min(std::max(guess, lower), v_high);
+			width = std::max(width, precision);
+			double a = std::max(guess - width, lower), b = std::min(guess + width, v_high);
+			double fa = residual(a), fb = residual(b);
 			
-			// while our volatility range is wider than the required precision
-			while(std::abs(v_high - v_low) >= precision)
+			while((fa > 0.0) == (fb > 0.0))
 			{
-				// managing the number of iterations
-				if(count++ >= max_iter)
+				// the bounds are reached: same answer as solve_implied_vol
+				if((fa > 0.0) ? (a == lower) : (b == v_high))
 				{
-					std::cout << "Dichotomy for implied vol did not converge in " << count << " iterations" << std::endl;
-					return 0;
+					result.vol = (fa > 0.0) ? a : b;
+					result.residual = (fa > 0.0) ? fa : fb;
+					result.converged = true;
+					return count_solve(result);
 				}
 				
-				// if standardized pnl is superior to tolerance
-				if((pnl / get_spot()) > tol) // standardize pnl because pnl is proportional to spot
+				// positive residuals: the vol is below the bracket, otherwise above
+				width *= 2.0;
+				if(fa > 0.0)
 				{
-					v_high = vol; // reduce upper bound
+					b = a;
+					fb = fa;
+					a = std::max(a - width, lower);
+					fa = residual(a);
 				}
 				else
 				{
-					v_low = vol; // otherwise reduce lower bound
+					a = b;
+					fa = fb;
+					b = std::min(b + width, v_high);
+					fb = residual(b);
+				}
+			}
+			
+			chandrupatla(residual, a, fa, b, fb, stop, precision, residual_precision, result);
+			return count_solve(result);
+		}
+		
+		
+		solver_result hedged_ptf::solve_implied_vol_ksection(std::size_t start, std::size_t end, double strike, bool robust_pnl,
+															 std::size_t nb_vols, double tol, double precision,
+															 double v_low, double v_high) const
+		{
+			// Generalization of the dichotomy: each pass over the range evaluates the pnl at nb_vols equally spaced
+			// vols inside the bracket (get_pnls), and the new bracket is the interval around the first vol with a
+			// positive standardized pnl minus tolerance. The bracket shrinks by a factor nb_vols + 1 per pass
+			// instead of 2, for the price of a single pass over the range.
+			// With a non-monotone pnl, the lowest change of sign is kept (the dichotomy keeps any of them).
+			
+			// same choice of call / put as solve_implied_vol
+			hedge_schedule schedule(*this, start, end); // shared by all the passes
+			bool call = (schedule.get_spots().back() - strike > 0.0) ? true : false;
+			double spot = schedule.get_spots().front();
+			nb_vols = std::max(nb_vols, static_cast<std::size_t>(1));
+			
+			solver_result result = {0.0, 0, 0, 0.0, false};
+			std::vector<double> vols(nb_vols), pnls(nb_vols), strikes(nb_vols, strike);
+			std::unique_ptr<bool[]> calls(new bool[nb_vols]);
+			std::fill(calls.get(), calls.get() + nb_vols, call);
+			
+			// residuals at the bounds of the bracket (NaN until evaluated, the initial bounds are not)
+			const double nan = std::numeric_limits<double>::quiet_NaN();
+			double f_low = nan, f_high = nan;
+			const std::size_t max_sweeps = 100;
+			
+			while(v_high - v_low >= precision)
+			{
+				if(result.sweeps == max_sweeps)
+				{
+					result.vol = (v_low + v_high) / 2.0;
+					return count_solve(result);
 				}
 				
-				// recompute midpoint and pnl
-				vol = (v_low + v_high) / 2.0;
-				pnl = robust_pnl ? get_robust_pnl(vol, call) : get_pnl(vol, call); // method depending on robust_pnl
+				// one pass for all the vols
+				double step = (v_high - v_low) / static_cast<double>(nb_vols + 1);
+				for(std::size_t j = 0; j < nb_vols; ++j)
+					vols[j] = v_low + static_cast<double>(j + 1) * step;
+				if(robust_pnl)
+					get_robust_pnls(schedule, strikes.data(), vols.data(), nb_vols, pnls.data());
+				else
+					get_pnls(schedule, strikes.data(), vols.data(), calls.get(), nb_vols, pnls.data());
+				++result.sweeps;
+				result.iterations += nb_vols;
+				
+				// first positive residual (a NaN pnl is treated as a zero pnl, as in solve_implied_vol)
+				std::size_t j = 0;
+				while((j < nb_vols) && !(pnls[j] / spot - tol > 0.0))
+					++j;
+				if(j > 0)
+				{
+					v_low = vols[j - 1];
+					f_low = pnls[j - 1] / spot - tol;
+				}
+				if(j < nb_vols)
+				{
+					v_high = vols[j];
+					f_high = pnls[j] / spot - tol;
+				}
 			}
-			return vol;
+			
+			// middle of the bracket as the dichotomy, residual of the closest evaluated bound
+			result.vol = (v_low + v_high) / 2.0;
+			result.residual = (!(std::abs(f_high) < std::abs(f_low)) && (f_low == f_low)) ? f_low : f_high;
+			result.converged = true;
+			return count_solve(result);
+		}
+		
+		
+		
+		void hedged_ptf::solve_implied_vols(std::size_t start, std::size_t end, const double* strikes, std::size_t n,
+											solver_result* results, bool robust_pnl, double tol, double precision,
+											double v_low, double v_high) const
+		{
+			solve_implied_vols(hedge_schedule(*this, start, end), strikes, n, results, robust_pnl, tol, precision, v_low, v_high);
+		}
+		
+		void hedged_ptf::solve_implied_vols(const hedge_schedule& schedule, const double* strikes, std::size_t n,
+											solver_result* results, bool robust_pnl, double tol, double precision,
+											double v_low, double v_high) const
+		{
+			// The dichotomy for all the strikes of a maturity together: at each step, the pnls of the middles of
+			// all the brackets are computed in one pass over the range (get_pnls), so the range is read once per
+			// step instead of once per step and per strike. The brackets all have the same width, they converge
+			// together (a strike stops being updated once its bracket is narrower than the precision).
+			
+			// same choice of call / put as solve_implied_vol, for each strike
+			std::unique_ptr<bool[]> calls(new bool[n]);
+			for(std::size_t j = 0; j < n; ++j)
+				calls[j] = (schedule.get_spots().back() - strikes[j] > 0.0) ? true : false;
+			double spot = schedule.get_spots().front();
+			
+			std::vector<double> low(n, v_low), high(n, v_high), vols(n), pnls(n);
+			for(std::size_t j = 0; j < n; ++j)
+				results[j] = {0.0, 0, 0, 0.0, false};
+			const std::size_t max_sweeps = 100;
+			
+			for(std::size_t sweep = 0; sweep < max_sweeps; ++sweep)
+			{
+				// brackets still too wide
+				std::size_t active = 0;
+				for(std::size_t j = 0; j < n; ++j)
+				{
+					vols[j] = (low[j] + high[j]) / 2.0;
+					active += (high[j] - low[j] >= precision) ? std::size_t(1) : std::size_t(0);
+				}
+				if(active == 0)
+					break;
+				
+				// one pass for all the strikes (the converged ones too, they keep the lanes aligned)
+				if(robust_pnl)
+					get_robust_pnls(schedule, strikes, vols.data(), n, pnls.data());
+				else
+					get_pnls(schedule, strikes, vols.data(), calls.get(), n, pnls.data());
 				
+				for(std::size_t j = 0; j < n; ++j)
+				{
+					if(high[j] - low[j] < precision)
+						continue;
+					++results[j].iterations;
+					++results[j].sweeps;
+					results[j].residual = pnls[j] / spot - tol;
+					// a NaN pnl is treated as a zero pnl
+					if(results[j].residual > 0.0)
+						high[j] = vols[j];
+					else
+						low[j] = vols[j];
+				}
+			}
+			
+			// middle of the brackets as the dichotomy
+			for(std::size_t j = 0; j < n; ++j)
+			{
+				results[j].vol = (low[j] + high[j]) / 2.0;
+				results[j].converged = (high[j] - low[j] < precision);
+				count_solve(results[j]);
+			}
+		}
+		
+		
+		
+		/* ------------------------ */
+		/* ---- HEDGE SCHEDULE ---- */
+		/* ------------------------ */
+		
+		// constructors
+		hedge_schedule::hedge_schedule(const hedged_ptf& ptf, std::size_t start, std::size_t end)
+			: m_start(start), m_end(end), m_rate(ptf.get_rate())
+		{
+			// columns of the range without copy (bounds checked once)
+			TS::series_window window = ptf.get_ts().window(start, end);
+			if(window.size() < 2)
+				throw "Error: hedging range out of the bounds of the data!";
+			const double* spot = window.values.data();
+			const double* years = window.years.data();
+			const double* returns = window.returns.data();
+			std::size_t size = window.size();
+			
+			m_spots.assign(window.values.begin(), window.values.end());
+			m_accruals.assign(window.accruals.begin(), window.accruals.end());
+			m_maturities.resize(size);
+			m_sqrt_maturities.resize(size);
+			m_discounts.resize(size);
+			m_log_moneyness.resize(size);
+			m_gamma_factors.resize(size);
+			m_dollar_variances.resize(size);
+			m_dollar_times.resize(size);
+			
+			// vectorized loops on local pointers (the exp and log of batch_bs)
+			double* mat = m_maturities.data();
+			double* sqrt_mat = m_sqrt_maturities.data();
+			double* disc = m_discounts.data();
+			double* log_moneyness = m_log_moneyness.data();
+			double* factors = m_gamma_factors.data();
+			double* dollar_variances = m_dollar_variances.data();
+			double* dollar_times = m_dollar_times.data();
+			double rate = m_rate, last = years[size - 1], inv_spot = 1.0 / spot[0];
+			for(std::size_t i = 0; i < size; ++i)
+			{
+				mat[i] = last - years[i];
+				sqrt_mat[i] = std::sqrt(mat[i]);
+				disc[i] = -rate * mat[i];
+				log_moneyness[i] = spot[i] * inv_spot;
+				factors[i] = 1.0 / (spot[i] * sqrt_mat[i]); // infinite on the last day (not used)
+			}
+			batch_exp(size, disc, disc);
+			batch_log(size, log_moneyness, log_moneyness);
+			
+			// previous spot^2 times squared return and time step
+			dollar_variances[0] = 0.0;
+			dollar_times[0] = 0.0;
+			for(std::size_t i = 1; i < size; ++i)
+			{
+				double dollar = spot[i - 1] * spot[i - 1];
+				dollar_variances[i] = dollar * returns[i] * returns[i];
+				dollar_times[i] = dollar * (years[i] - years[i - 1]);
+			}
+		}
+		
+		
+		
+		// access - range
+		std::size_t hedge_schedule::get_start() const
+		{
+			return m_start;
+		}
+		
+		std::size_t hedge_schedule::get_end() const
+		{
+			return m_end;
+		}
+		
+		std::size_t hedge_schedule::get_size() const
+		{
+			return m_spots.size();
+		}
+		
+		double hedge_schedule::get_rate() const
+		{
+			return m_rate;
+		}
+		
+		
+		
+		// access - columns
+		const std::vector<double>& hedge_schedule::get_spots() const
+		{
+			return m_spots;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_maturities() const
+		{
+			return m_maturities;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_sqrt_maturities() const
+		{
+			return m_sqrt_maturities;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_discounts() const
+		{
+			return m_discounts;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_log_moneyness() const
+		{
+			return m_log_moneyness;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_accruals() const
+		{
+			return m_accruals;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_gamma_factors() const
+		{
+			return m_gamma_factors;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_dollar_variances() const
+		{
+			return m_dollar_variances;
+		}
+		
+		const std::vector<double>& hedge_schedule::get_dollar_times() const
+		{
+			return m_dollar_times;
 		}
 		
 		
@@ -477,7 +1433,7 @@ namespace project
 			// testing if the two bounds have the same sign
 			if (get_pnl(v_low,call)*get_pnl(v_high,call)>0)
 			{
-				std::cout<< "Error in dichotomy method" << std::endl;
+				PROJECT_LOG_ERROR("Error in dichotomy method");
 			}
 			
 			// initialization
@@ -498,7 +1454,7 @@ namespace project
 			{
 				if(++count == 1.0/precision)
 				{
-					std::cout << "Dichotomy for implied vol did not converge" << std::endl;
+					PROJECT_LOG_WARNING("Dichotomy for implied vol did not converge");
 					return 0;
 				}
 				if(pnl > 0)
@@ -4,12 +4,16 @@
 // libs of the project
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cmath>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <string>
@@ -27,6 +31,45 @@ namespace project
 		/* ---- DELTA-HEDGED PORTFOLIO ---- */
 		/* -------------------------------- */
 		
+		// stopping criteria of the implied vol solver
+		enum class stop_criterion
+		{
+			bracket, // the bracket around the implied vol is narrower than the precision (as the dichotomy)
+			residual, // the standardized pnl is closer to the tolerance than the residual precision
+			either // the first of the two
+		};
+		
+		// result of the implied vol solver
+		struct solver_result
+		{
+			double vol;
+			std::size_t iterations; // number of pnl evaluations
+			std::size_t sweeps; // number of passes over the range (several pnl evaluations per pass for the k-section)
+			double residual; // standardized pnl minus tolerance at vol
+			bool converged;
+		};
+		
+		// counters of the pnl computations of a portfolio (since its creation or the last reset_metrics, all threads)
+		struct ptf_metrics
+		{
+			std::uint64_t pnl_evaluations; // pnl of one option on one range
+			std::uint64_t passes; // passes over a range (one pass evaluates several options with get_pnls)
+			std::uint64_t days; // days processed by these passes
+			std::uint64_t solves; // implied vol solves
+			std::uint64_t failed_solves; // solves that did not converge
+		};
+		
+		// accounting of the pnl of the hedged option
+		enum class pnl_method
+		{
+			self_financing, // daily delta hedge, the rest invested at the risk-free rate (get_pnl)
+			delta_only, // same without the interests of the cash (get_delta_pnl)
+			gamma_weighted // dollar gamma weighted realized minus implied variance (get_robust_pnl)
+		};
+		
+		// invariants of a hedging range, see below
+		class hedge_schedule;
+		
 		// class of the delta-hedged portfolio we will manipulate
 		class hedged_ptf
 		{
@@ -35,6 +78,8 @@ namespace project
 			// constructors
 			hedged_ptf(const std::string& name, std::ifstream& csv_file,
 					   double strike = 100.0, double rate = 0.01, double div = 0.0);
+			hedged_ptf(const std::string& name, const std::string& path, // memory-mapped file (see time_series)
+					   double strike = 100.0, double rate = 0.01, double div = 0.0, std::size_t nb_threads = 0);
 			
 			// destructor
 			~hedged_ptf();
@@ -51,10 +96,16 @@ namespace project
 			double get_strike() const;
 			double get_rate() const;
 			double get_div() const;
+			accuracy get_accuracy() const;
+			TS::day_count get_day_count() const; // of the time_series
 			
 			// access - time_series
 			const TS::time_series& get_ts() const;
 			
+			// access - metrics
+			ptf_metrics get_metrics() const;
+			void reset_metrics();
+			
 			// access - date range
 			std::size_t get_start() const;
 			std::size_t get_end() const;
@@ -73,6 +124,19 @@ namespace project
 			void let_strike(double strike, bool percent = true);
 			void let_rate(double rate);
 			void let_div(double div);
+			// accuracy of the normal distributions in the pnl computations (see batch_bs), full by default
+			// high / fast halve the cost of batch_bs; the robust pnl vols move by less than 1e-10 but the delta pnl
+			// vols of deep in / out of the money cells, whose root is at the noise floor of the pnl, can move by ~2e-4
+			// single: the fast approximations in float, the pnl still summed in double; against fast (data.csv), the
+			// robust pnl vols move by ~3e-8 and the delta pnl vols of the same noise floor cells by ~3e-6
+			void let_accuracy(accuracy acc);
+			// day-count convention of the maturities and accruals (see TS::day_count), ACT/365 by default
+			// the year fractions are tabulated once by the time_series: the hedging loops do not depend on it
+			void let_day_count(TS::day_count convention);
+			
+			// modify - data
+			// new observation (see time_series::append), a range ending on the last line follows it
+			bool append(TS::day_t day, double value);
 			
 			// modify - date range
 			void let_start(std::size_t start);
@@ -82,6 +146,7 @@ namespace project
 			
 			// sets range to last n months (for vol computations)
 			void let_last_range(std::size_t n, bool next = true); // uses shift_months
+			std::size_t get_last_start(std::size_t n, bool next = true) const; // start of this range
 			
 			
 			// P&L computations
@@ -89,8 +154,78 @@ namespace project
 			double get_delta_pnl(double vol, bool call = true) const; // only delta effect
 			double get_robust_pnl(double vol, bool call = true) const; // gamma weighted average method
 			
+			// P&L computations on a given range and (absolute) strike
+			// reentrant: do not depend on the current range / strike, can be called from several threads
+			// these versions and the solvers on a range throw if the range is out of the data (see hedge_schedule)
+			double get_pnl(std::size_t start, std::size_t end, double strike, double vol, bool call = true) const;
+			double get_delta_pnl(std::size_t start, std::size_t end, double strike, double vol, bool call = true) const;
+			double get_robust_pnl(std::size_t start, std::size_t end, double strike, double vol, bool call = true) const;
+			
+			// P&L computations for n options in one pass over the range (prices and year fractions loaded once)
+			void get_pnls(std::size_t start, std::size_t end, double strike, const double* vols, std::size_t n,
+						  double* pnls, bool call = true) const; // n vols
+			void get_pnls(std::size_t start, std::size_t end, const double* strikes, const double* vols,
+						  const bool* calls, std::size_t n, double* pnls) const; // n (strike, vol, call/put)
+			void get_robust_pnls(std::size_t start, std::size_t end, double strike, const double* vols, std::size_t n,
+								 double* pnls, bool call = true) const; // the side does not change the gamma
+			void get_robust_pnls(std::size_t start, std::size_t end, const double* strikes, const double* vols,
+								 std::size_t n, double* pnls) const;
+			
+			// same computations on a precomputed range (see hedge_schedule): only the vol-dependent terms are
+			// computed, the versions above build a schedule for each call
+			double get_pnl(const hedge_schedule& schedule, double strike, double vol, bool call = true) const;
+			double get_delta_pnl(const hedge_schedule& schedule, double strike, double vol, bool call = true) const;
+			double get_robust_pnl(const hedge_schedule& schedule, double strike, double vol, bool call = true) const;
+			void get_pnls(const hedge_schedule& schedule, const double* strikes, const double* vols,
+						  const bool* calls, std::size_t n, double* pnls) const;
+			void get_robust_pnls(const hedge_schedule& schedule, const double* strikes, const double* vols,
+								 std::size_t n, double* pnls) const;
+			
+			// pnl of one option on a schedule, specialized at compile time on the side, the method, a zero rate and
+			// the scalar type of the normal distributions (float for accuracy::single, the pnl is summed in double):
+			// selected once (eg. per cell by the solvers), then called as (ptf.*kernel)(schedule, strike, vol)
+			using pnl_kernel = double (hedged_ptf::*)(const hedge_schedule& schedule, double strike, double vol) const;
+			static pnl_kernel select_pnl(pnl_method method, bool call, bool zero_rate, accuracy acc = accuracy::full);
+			
 			// implied vol computations
 			double get_implied_vol(bool robust_pnl = false, double tol = 1e-13, double precision = 1e-5, double v_low = 0.0, double v_high = 1.0) const;
+			double get_implied_vol(std::size_t start, std::size_t end, double strike, bool robust_pnl = false, // reentrant version
+								   double tol = 1e-13, double precision = 1e-5, double v_low = 0.0, double v_high = 1.0) const;
+			
+			// implied vol solver (Chandrupatla's variant of Brent's method) with its diagnostics
+			solver_result solve_implied_vol(std::size_t start, std::size_t end, double strike, bool robust_pnl = false,
+											stop_criterion stop = stop_criterion::bracket, double tol = 1e-13,
+											double precision = 1e-5, double v_low = 0.0, double v_high = 1.0,
+											double residual_precision = 1e-8) const;
+			// same solver warm-started from a guess (eg. the vol of the previous day), see hedged_ptf.cpp
+			solver_result solve_implied_vol_from(std::size_t start, std::size_t end, double strike, double guess,
+												 bool robust_pnl = false, double width = 0.002,
+												 stop_criterion stop = stop_criterion::bracket, double tol = 1e-13,
+												 double precision = 1e-5, double v_low = 0.0, double v_high = 1.0,
+												 double residual_precision = 1e-8) const;
+			// k-section solver: nb_vols pnls per pass, the bracket shrinks by a factor nb_vols + 1 per pass
+			solver_result solve_implied_vol_ksection(std::size_t start, std::size_t end, double strike, bool robust_pnl = false,
+													 std::size_t nb_vols = 8, double tol = 1e-13, double precision = 1e-5,
+													 double v_low = 0.0, double v_high = 1.0) const;
+			// dichotomies of n strikes in lock-step: one pass over the range per step for all the strikes
+			void solve_implied_vols(std::size_t start, std::size_t end, const double* strikes, std::size_t n,
+									solver_result* results, bool robust_pnl = false, double tol = 1e-13,
+									double precision = 1e-5, double v_low = 0.0, double v_high = 1.0) const;
+			
+			// same solvers on a precomputed range, shared by all the strikes of a maturity
+			// (the versions above build one schedule per solve, reused by all its iterations)
+			solver_result solve_implied_vol(const hedge_schedule& schedule, double strike, bool robust_pnl = false,
+											stop_criterion stop = stop_criterion::bracket, double tol = 1e-13,
+											double precision = 1e-5, double v_low = 0.0, double v_high = 1.0,
+											double residual_precision = 1e-8) const;
+			solver_result solve_implied_vol_from(const hedge_schedule& schedule, double strike, double guess,
+												 bool robust_pnl = false, double width = 0.002,
+												 stop_criterion stop = stop_criterion::bracket, double tol = 1e-13,
+												 double precision = 1e-5, double v_low = 0.0, double v_high = 1.0,
+												 double residual_precision = 1e-8) const;
+			void solve_implied_vols(const hedge_schedule& schedule, const double* strikes, std::size_t n,
+									solver_result* results, bool robust_pnl = false, double tol = 1e-13,
+									double precision = 1e-5, double v_low = 0.0, double v_high = 1.0) const;
 			double get_implied_vol_old(double precision = 1e-5, double v_low = 0.0, double v_high = 1.0) const;
 			
 			
@@ -104,13 +239,98 @@ namespace project
 			double m_strike;
 			double m_rate;
 			double m_div;
+			accuracy m_accuracy;
 			
 			// time_series
 			TS::time_series m_ts;
 			std::size_t m_start;
 			std::size_t m_end;
 			
+			// metrics (counted by the const methods, from any thread)
+			struct metrics_counters
+			{
+				std::atomic<std::uint64_t> pnl_evaluations;
+				std::atomic<std::uint64_t> passes;
+				std::atomic<std::uint64_t> days;
+				std::atomic<std::uint64_t> solves;
+				std::atomic<std::uint64_t> failed_solves;
+				
+				metrics_counters();
+				metrics_counters(const metrics_counters& other);
+				metrics_counters& operator=(const metrics_counters& other);
+			};
+			mutable metrics_counters m_counters;
+			
+			void count_pass(std::size_t n, std::size_t size) const;
+			const solver_result& count_solve(const solver_result& result) const;
+			
+			// vol-dependent terms of the pnl on a schedule (in double, or in float for accuracy::single)
+			template<typename Scalar>
+			void get_d1(const hedge_schedule& schedule, double strike, double vol, Scalar* d1) const;
+			template<typename Scalar>
+			void get_deltas(const hedge_schedule& schedule, double strike, double vol, bool call, Scalar* delta) const;
+			
+			// hedging engine, one instantiation per side, pnl method, rate regime and scalar type (see hedged_ptf.cpp)
+			template<class Side, class Method, class Rate, typename Scalar>
+			double hedge(const hedge_schedule& schedule, double strike, double vol) const;
+			template<typename Scalar>
+			static pnl_kernel select_kernel(pnl_method method, bool call, bool zero_rate);
+			
+			
+		};
+		
+		
+		
+		
+		/* ------------------------ */
+		/* ---- HEDGE SCHEDULE ---- */
+		/* ------------------------ */
+		
+		// invariants of a hedging range for a given rate: everything that does not depend on the strike and the vol,
+		// computed once and reused by all the pnl evaluations on the range (solver iterations and strikes)
+		// the columns are copies: the schedule stays valid after ptf.append() or ptf.let_rate(), for the data and the
+		// rate it was built with
+		class hedge_schedule
+		{
+		public:
+			
+			// constructors (throws if [start, end] is not a range of at least two lines of the data)
+			hedge_schedule(const hedged_ptf& ptf, std::size_t start, std::size_t end);
+			
+			// access - range
+			std::size_t get_start() const;
+			std::size_t get_end() const;
+			std::size_t get_size() const;
+			double get_rate() const;
+			
+			// access - columns (index 0 is the start of the range)
+			const std::vector<double>& get_spots() const;
+			const std::vector<double>& get_maturities() const; // times to maturity
+			const std::vector<double>& get_sqrt_maturities() const;
+			const std::vector<double>& get_discounts() const; // exp(-rate * maturity)
+			const std::vector<double>& get_log_moneyness() const; // log(spot / spot at the start)
+			const std::vector<double>& get_accruals() const; // exp(rate * dt) - 1 from the previous line
+			const std::vector<double>& get_gamma_factors() const; // 1 / (spot * sqrt(maturity)), gamma = pdf(d1) / vol * factor
+			const std::vector<double>& get_dollar_variances() const; // previous spot^2 * return^2 (first element is 0)
+			const std::vector<double>& get_dollar_times() const; // previous spot^2 * dt (first element is 0)
+			
+			
+		private:
+			
+			// data members
+			std::size_t m_start;
+			std::size_t m_end;
+			double m_rate;
 			
+			std::vector<double> m_spots;
+			std::vector<double> m_maturities;
+			std::vector<double> m_sqrt_maturities;
+			std::vector<double> m_discounts;
+			std::vector<double> m_log_moneyness;
+			std::vector<double> m_accruals;
+			std::vector<double> m_gamma_factors;
+			std::vector<double> m_dollar_variances;
+			std::vector<double> m_dollar_times;
 		};
 
 	}
@@ -0,0 +1,108 @@
+#include "logger.hpp"
+
+namespace project
+{
+
+	/* ----------------- */
+	/* ---- LOGGING ---- */
+	/* ----------------- */
+
+	namespace LOG
+	{
+
+		std::atomic<int> g_level(static_cast<int>(level::info));
+
+		namespace
+		{
+			// the sinks are behind a mutex: messages of several threads are not interleaved
+			std::mutex& sinks_mutex()
+			{
+				static std::mutex mutex;
+				return mutex;
+			}
+
+			std::vector<sink>& sinks()
+			{
+				static std::vector<sink> list {console_sink()};
+				return list;
+			}
+		}
+
+
+
+		// runtime level
+		void let_level(level lvl)
+		{
+			g_level.store(static_cast<int>(lvl), std::memory_order_relaxed);
+		}
+
+		level get_level()
+		{
+			return static_cast<level>(g_level.load(std::memory_order_relaxed));
+		}
+
+
+
+		// sinks
+		void add_sink(sink s)
+		{
+			std::lock_guard<std::mutex> lock(sinks_mutex());
+			sinks().push_back(std::move(s));
+		}
+
+		void clear_sinks()
+		{
+			std::lock_guard<std::mutex> lock(sinks_mutex());
+			sinks().clear();
+		}
+
+		sink console_sink()
+		{
+			return [](level lvl, const std::string& message)
+			{
+				std::ostream& stream = (lvl >= level::warning) ? std::cerr : std::cout;
+				stream << message << std::endl;
+			};
+		}
+
+		sink file_sink(const std::string& path)
+		{
+			// shared by the copies of the sink
+			std::shared_ptr<std::ofstream> file = std::make_shared<std::ofstream>(path, std::ios::app);
+			if(!*file)
+				throw "Error: log file could not be opened!";
+			return [file](level lvl, const std::string& message)
+			{
+				*file << '[' << to_string(lvl) << "] " << message << '\n';
+				if(lvl >= level::warning)
+					file->flush();
+			};
+		}
+
+
+
+		std::string to_string(level lvl)
+		{
+			switch(lvl)
+			{
+				case level::debug: return "debug";
+				case level::info: return "info";
+				case level::warning: return "warning";
+				case level::error: return "error";
+				default: return "off";
+			}
+		}
+
+
+
+		// sends a formatted message to the sinks
+		void write(level lvl, const std::string& message)
+		{
+			std::lock_guard<std::mutex> lock(sinks_mutex());
+			for(const sink& s : sinks())
+				s(lvl, message);
+		}
+
+	}
+
+}
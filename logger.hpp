@@ -0,0 +1,91 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+// libs of the project
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// messages below this level are removed at compile time (0: debug, 1: info, 2: warning, 3: error, 4: off)
+// eg. -DPROJECT_LOG_MIN_LEVEL=2 for batch builds that only report the problems
+#ifndef PROJECT_LOG_MIN_LEVEL
+#define PROJECT_LOG_MIN_LEVEL 0
+#endif
+
+namespace project
+{
+
+	/* ----------------- */
+	/* ---- LOGGING ---- */
+	/* ----------------- */
+
+	namespace LOG
+	{
+
+		enum class level : int
+		{
+			debug = 0, // setters and destructors
+			info = 1, // loads, computations and exports
+			warning = 2, // solvers that did not converge
+			error = 3, // invalid calls and files
+			off = 4
+		};
+
+		// a sink receives the messages of the enabled levels (one call at a time)
+		typedef std::function<void(level, const std::string&)> sink;
+
+		// runtime level (info by default)
+		void let_level(level lvl);
+		level get_level();
+
+		// a disabled message costs one relaxed load: it is neither formatted nor sent
+		extern std::atomic<int> g_level;
+		inline bool enabled(level lvl)
+		{
+			return static_cast<int>(lvl) >= g_level.load(std::memory_order_relaxed);
+		}
+
+		// sinks (the console sink only by default)
+		void add_sink(sink s);
+		void clear_sinks(); // without sink the messages are dropped
+		sink console_sink(); // debug and info to std::cout, warning and error to std::cerr
+		sink file_sink(const std::string& path); // appends "[level] message" lines to a file
+
+		std::string to_string(level lvl);
+
+		// sends a formatted message to the sinks (use the macros below)
+		void write(level lvl, const std::string& message);
+
+	}
+
+}
+
+
+// logging macros: the message is a stream expression, only evaluated if the level is enabled
+// eg. PROJECT_LOG_INFO("vol_surface " << get_name() << " correctly updated");
+#define PROJECT_LOG(lvl, message) \
+	do \
+	{ \
+		if(static_cast<int>(lvl) >= PROJECT_LOG_MIN_LEVEL && ::project::LOG::enabled(lvl)) \
+		{ \
+			std::ostringstream project_log_stream; \
+			project_log_stream << message; \
+			::project::LOG::write(lvl, project_log_stream.str()); \
+		} \
+	} while(false)
+
+#define PROJECT_LOG_DEBUG(message) PROJECT_LOG(::project::LOG::level::debug, message)
+#define PROJECT_LOG_INFO(message) PROJECT_LOG(::project::LOG::level::info, message)
+#define PROJECT_LOG_WARNING(message) PROJECT_LOG(::project::LOG::level::warning, message)
+#define PROJECT_LOG_ERROR(message) PROJECT_LOG(::project::LOG::level::error, message)
+
+
+
+#endif
@@ -2,6 +2,7 @@
 #include "hedged_ptf.hpp"
 #include "vol_surface.hpp"
 #include "functions.hpp"
+#include "backtest.hpp"
 
 
 void print_diff(const std::vector<double>& v1, const std::vector<double>& v2)
@@ -19,12 +20,8 @@ void print_diff(const std::vector<double>& v1, const std::vector<double>& v2)
 int main(int argc, char* argv[])
 {
     
-	// 1. open the datafile
-	std::ifstream data_file("../data.csv", std::ios_base::in);
-	
-	// 2. create a hedged_ptf instance using the datafile
-	project::BS::hedged_ptf ptf("S&P", data_file);
-	data_file.close();
+	// 1. & 2. create a hedged_ptf instance using the datafile (memory-mapped and parsed in parallel)
+	project::BS::hedged_ptf ptf("S&P", "../data.csv");
 	
 	// 3. setting the ptf + printing infos
 	ptf.let_rate(0.01);
@@ -49,9 +46,14 @@ int main(int argc, char* argv[])
 	// 7. export the results to .csv file
 	vs.export_to_csv(/* optional path */);
 	vs_robust.export_to_csv(/* optional path */);
+	// vs.export_diagnostics_to_csv(/* optional path */); // solver diagnostics of each cell
 	
 	// 8. quickly compare differences (easier in Excel with a heatmap...)
 	// print_diff(vs.get_strike(100), vs_robust.get_strike(100));
+	
+	// 9. rolling backtest: the surface of every as-of date, streamed to a .csv file (long)
+	// project::VS::surface_backtest bt(ptf);
+	// bt.run("../S&P_backtest.csv", 2, ptf.get_size());
 
 	
 	return 0;
@@ -0,0 +1,306 @@
+#include "surface_file.hpp"
+
+namespace project
+{
+	
+	namespace VS
+	{
+		
+		namespace
+		{
+			// binary surface file, in the byte order of the machine (checked when reading):
+			// records | index | trailer (32 bytes)
+			// record: header (64 bytes) | name (padded to 8 bytes) | strikes | maturities | vols (doubles, by maturity)
+			// index: one entry per record (offset and size of the name) | names (padded to 8 bytes)
+			struct record_header
+			{
+				char magic[8];
+				std::uint64_t nstrikes;
+				std::uint64_t nmaturities;
+				std::uint32_t name_size;
+				std::uint32_t flags;
+				std::int32_t as_of;
+				std::uint32_t reserved[7];
+			};
+			static_assert(sizeof(record_header) == 64, "surface record header must be 64 bytes");
+			
+			struct index_entry
+			{
+				std::uint64_t offset;
+				std::uint64_t name_size;
+			};
+			
+			struct file_trailer
+			{
+				char magic[8];
+				std::uint32_t version;
+				std::uint32_t byte_order;
+				std::uint64_t index_offset;
+				std::uint64_t count;
+			};
+			static_assert(sizeof(file_trailer) == 32, "surface file trailer must be 32 bytes");
+			
+			const char record_magic[8] = {'V', 'S', 'R', 'E', 'C', 'O', 'R', 'D'};
+			const char trailer_magic[8] = {'V', 'S', 'I', 'N', 'D', 'E', 'X', '\0'};
+			const std::uint32_t surface_version = 1;
+			const std::uint32_t surface_byte_order = 0x01020304;
+			const std::uint32_t surface_robust_pnl = 1;
+			
+			// records are written by blocks of at least 1MB
+			const std::size_t buffer_size = std::size_t(1) << 20;
+			
+			std::size_t padded(std::size_t size)
+			{
+				return (size + 7) / 8 * 8;
+			}
+			
+			void append_bytes(std::string& buffer, const void* data, std::size_t size)
+			{
+				buffer.append(static_cast<const char*>(data), size);
+			}
+			
+			void append_padding(std::string& buffer, std::size_t size)
+			{
+				buffer.append(padded(size) - size, '\0');
+			}
+		}
+		
+		
+		
+		/* ------------------------ */
+		/* ---- SURFACE WRITER ---- */
+		/* ------------------------ */
+		
+		// constructors
+		surface_writer::surface_writer(const std::string& path, bool append)
+			: m_path(path), m_offset(0), m_open(false)
+		{
+			// the surfaces of an existing file are kept: the new records replace its index
+			bool exists = append && std::ifstream(path).is_open();
+			if(exists)
+			{
+				surface_reader reader(path);
+				for(std::size_t k = 0; k < reader.get_size(); ++k)
+					m_index.push_back(entry {reader.m_offsets[k], reader.m_names[k]});
+				m_offset = reader.m_index_offset;
+			}
+			
+			std::ios_base::openmode mode = std::ios_base::out | std::ios_base::binary;
+			if(exists)
+				mode |= std::ios_base::in; // no truncation
+			m_file.open(path, mode);
+			if(!m_file.is_open())
+				throw "Error: surface file could not be created!";
+			m_file.seekp(static_cast<std::streamoff>(m_offset));
+			m_buffer.reserve(2 * buffer_size);
+			m_open = true;
+		}
+		
+		
+		
+		// destructor
+		surface_writer::~surface_writer()
+		{
+			close();
+		}
+		
+		
+		
+		
+		// access
+		std::string surface_writer::get_path() const
+		{
+			return m_path;
+		}
+		
+		std::size_t surface_writer::get_size() const
+		{
+			return m_index.size();
+		}
+		
+		
+		
+		
+		// writing
+		void surface_writer::write(const surface_data& surface)
+		{
+			write(surface.name, surface.strikes, surface.maturities, surface.vols.data(), surface.robust_pnl, surface.as_of);
+		}
+		
+		void surface_writer::write(const std::string& name, const std::vector<double>& strikes, const std::vector<double>& maturities,
+								   const double* vols, bool robust_pnl, TS::day_t as_of)
+		{
+			if(!m_open)
+			{
+				PROJECT_LOG_ERROR("Error: surface " << name << " written to the closed file " << m_path);
+				return;
+			}
+			
+			record_header header = {};
+			std::memcpy(header.magic, record_magic, sizeof(record_magic));
+			header.nstrikes = strikes.size();
+			header.nmaturities = maturities.size();
+			header.name_size = static_cast<std::uint32_t>(name.size());
+			header.flags = robust_pnl ? surface_robust_pnl : 0;
+			header.as_of = as_of;
+			
+			m_index.push_back(entry {m_offset + m_buffer.size(), name});
+			append_bytes(m_buffer, &header, sizeof(header));
+			append_bytes(m_buffer, name.data(), name.size());
+			append_padding(m_buffer, name.size());
+			append_bytes(m_buffer, strikes.data(), strikes.size() * sizeof(double));
+			append_bytes(m_buffer, maturities.data(), maturities.size() * sizeof(double));
+			append_bytes(m_buffer, vols, strikes.size() * maturities.size() * sizeof(double));
+			
+			if(m_buffer.size() >= buffer_size)
+				flush();
+		}
+		
+		void surface_writer::close()
+		{
+			if(!m_open)
+				return;
+			
+			// index then trailer, after the last record
+			file_trailer trailer = {};
+			std::memcpy(trailer.magic, trailer_magic, sizeof(trailer_magic));
+			trailer.version = surface_version;
+			trailer.byte_order = surface_byte_order;
+			trailer.index_offset = m_offset + m_buffer.size();
+			trailer.count = m_index.size();
+			for(const entry& e : m_index)
+			{
+				index_entry item = {e.offset, e.name.size()};
+				append_bytes(m_buffer, &item, sizeof(item));
+			}
+			for(const entry& e : m_index)
+			{
+				append_bytes(m_buffer, e.name.data(), e.name.size());
+				append_padding(m_buffer, e.name.size());
+			}
+			append_bytes(m_buffer, &trailer, sizeof(trailer));
+			flush();
+			m_file.close();
+			m_open = false;
+			
+			if(m_file.good())
+				PROJECT_LOG_INFO(m_index.size() << " surfaces written to " << m_path);
+			else
+				PROJECT_LOG_ERROR("Error: surface file " << m_path << " could not be written");
+		}
+		
+		void surface_writer::flush()
+		{
+			m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+			m_offset += m_buffer.size();
+			m_buffer.clear();
+		}
+		
+		
+		
+		/* ------------------------ */
+		/* ---- SURFACE READER ---- */
+		/* ------------------------ */
+		
+		// constructors
+		surface_reader::surface_reader(const std::string& path)
+			: m_file(std::make_shared<csv::mapped_file>(path)), m_index_offset(0)
+		{
+			const char* data = m_file->data();
+			std::uint64_t size = m_file->size();
+			if(size < sizeof(file_trailer))
+				throw "Error: not a surface file!";
+			
+			file_trailer trailer;
+			std::memcpy(&trailer, data + size - sizeof(trailer), sizeof(trailer));
+			if(std::memcmp(trailer.magic, trailer_magic, sizeof(trailer_magic)) != 0)
+				throw "Error: not a surface file!";
+			if(trailer.byte_order != surface_byte_order)
+				throw "Error: surface file written on a machine with another byte order!";
+			if(trailer.version != surface_version)
+				throw "Error: unsupported surface file version!";
+			
+			// the index has to be inside the file
+			std::uint64_t end = size - sizeof(trailer);
+			if((trailer.index_offset > end) || (trailer.count > (end - trailer.index_offset) / sizeof(index_entry)))
+				throw "Error: truncated surface file!";
+			
+			m_index_offset = trailer.index_offset;
+			std::size_t count = static_cast<std::size_t>(trailer.count);
+			const char* entries = data + trailer.index_offset;
+			std::uint64_t names = trailer.index_offset + count * sizeof(index_entry);
+			m_offsets.resize(count);
+			m_names.resize(count);
+			for(std::size_t k = 0; k < count; ++k)
+			{
+				index_entry item;
+				std::memcpy(&item, entries + k * sizeof(item), sizeof(item));
+				if((item.offset + sizeof(record_header) > trailer.index_offset) || (names > end) || (item.name_size > end - names))
+					throw "Error: truncated surface file!";
+				m_offsets[k] = item.offset;
+				m_names[k].assign(data + names, static_cast<std::size_t>(item.name_size));
+				names += padded(static_cast<std::size_t>(item.name_size));
+			}
+		}
+		
+		
+		
+		// access
+		std::size_t surface_reader::get_size() const
+		{
+			return m_offsets.size();
+		}
+		
+		const std::vector<std::string>& surface_reader::get_names() const
+		{
+			return m_names;
+		}
+		
+		std::size_t surface_reader::find(const std::string& name) const
+		{
+			return static_cast<std::size_t>(std::find(m_names.cbegin(), m_names.cend(), name) - m_names.cbegin());
+		}
+		
+		surface_data surface_reader::read(std::size_t k) const
+		{
+			if(k >= m_offsets.size())
+				throw "Error: surface not found in the file!";
+			
+			const char* data = m_file->data();
+			std::uint64_t offset = m_offsets[k];
+			record_header header;
+			std::memcpy(&header, data + offset, sizeof(header));
+			if(std::memcmp(header.magic, record_magic, sizeof(record_magic)) != 0)
+				throw "Error: invalid surface record!";
+			
+			// the record has to end before the index (the header does, see the constructor): name, then
+			// nstrikes + nmaturities + nstrikes * nmaturities doubles, checked without overflow
+			std::uint64_t nstrikes = header.nstrikes, nmaturities = header.nmaturities;
+			std::uint64_t available = m_index_offset - offset - sizeof(header);
+			if(padded(header.name_size) > available)
+				throw "Error: truncated surface record!";
+			std::uint64_t doubles = (available - padded(header.name_size)) / sizeof(double);
+			if(   (nstrikes > doubles) || (nmaturities > doubles - nstrikes)
+			   || ((nmaturities != 0) && (nstrikes > (doubles - nstrikes - nmaturities) / nmaturities)))
+				throw "Error: truncated surface record!";
+			
+			surface_data surface;
+			const char* p = data + offset + sizeof(header);
+			surface.name.assign(p, header.name_size);
+			surface.robust_pnl = (header.flags & surface_robust_pnl) != 0;
+			surface.as_of = header.as_of;
+			p += padded(header.name_size);
+			
+			std::size_t ns = static_cast<std::size_t>(nstrikes), nm = static_cast<std::size_t>(nmaturities);
+			surface.strikes.resize(ns);
+			surface.maturities.resize(nm);
+			surface.vols.resize(ns * nm);
+			std::memcpy(surface.strikes.data(), p, ns * sizeof(double));
+			std::memcpy(surface.maturities.data(), p + ns * sizeof(double), nm * sizeof(double));
+			std::memcpy(surface.vols.data(), p + (ns + nm) * sizeof(double), ns * nm * sizeof(double));
+			return surface;
+		}
+		
+	}
+	
+}
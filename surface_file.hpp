@@ -0,0 +1,123 @@
+#ifndef SURFACE_FILE_HPP
+#define SURFACE_FILE_HPP
+
+// libs of the project
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "functions.hpp" // mapped files and day numbers
+
+namespace project
+{
+	
+	namespace VS
+	{
+		
+		/* ------------------------------- */
+		/* ---- BINARY SURFACE FILES ---- */
+		/* ------------------------------- */
+		
+		// one surface of a file: grid, metadata and vols (by maturity, as vol_surface)
+		struct surface_data
+		{
+			std::string name;
+			bool robust_pnl; // method of the pnl computation
+			TS::day_t as_of; // last date of the data (0 if unknown)
+			std::vector<double> strikes;
+			std::vector<double> maturities;
+			std::vector<double> vols; // maturities x strikes
+		};
+		
+		// writes surfaces to a binary file, in the byte order of the machine (see surface_file.cpp):
+		// the records are buffered and written by large blocks, the index of the surfaces is written on close
+		// with append, the surfaces are added after the ones of an existing file (its index is rewritten)
+		class surface_writer
+		{
+		public:
+			
+			// constructors (throws if the file can not be opened or is not a surface file)
+			explicit surface_writer(const std::string& path, bool append = false);
+			
+			// destructor (closes the file)
+			~surface_writer();
+			
+			// no copy
+			surface_writer(const surface_writer&) = delete;
+			surface_writer& operator=(const surface_writer&) = delete;
+			
+			// access
+			std::string get_path() const;
+			std::size_t get_size() const; // number of surfaces in the file
+			
+			// adds a surface (vols: maturities x strikes)
+			void write(const surface_data& surface);
+			void write(const std::string& name, const std::vector<double>& strikes, const std::vector<double>& maturities,
+					   const double* vols, bool robust_pnl = false, TS::day_t as_of = 0);
+			
+			// writes the buffer and the index (nothing can be written after)
+			void close();
+		
+		
+		private:
+			
+			// index of a surface: position of its record and its name
+			struct entry
+			{
+				std::uint64_t offset;
+				std::string name;
+			};
+			
+			// data members
+			std::string m_path;
+			std::ofstream m_file;
+			std::string m_buffer; // records not written yet
+			std::uint64_t m_offset; // position of the end of the buffer in the file
+			std::vector<entry> m_index;
+			bool m_open;
+			
+			void flush();
+		};
+		
+		// reads the surfaces of a binary file (memory-mapped, the index is read when opening)
+		class surface_reader
+		{
+		public:
+			
+			// constructors (throws if the file can not be opened or is not a valid surface file)
+			explicit surface_reader(const std::string& path);
+			
+			// access
+			std::size_t get_size() const; // number of surfaces
+			const std::vector<std::string>& get_names() const;
+			std::size_t find(const std::string& name) const; // first surface with this name, get_size() if none
+			
+			// copy of a surface (throws if the record is not valid)
+			surface_data read(std::size_t k) const;
+		
+		
+		private:
+			
+			// data members
+			std::shared_ptr<csv::mapped_file> m_file;
+			std::vector<std::uint64_t> m_offsets;
+			std::vector<std::string> m_names;
+			std::uint64_t m_index_offset; // end of the records
+			
+			// the writer appends after the records of an existing file
+			friend class surface_writer;
+		};
+		
+	}
+	
+}
+
+
+
+#endif
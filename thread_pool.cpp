@@ -0,0 +1,153 @@
+#include "thread_pool.hpp"
+
+namespace project
+{
+
+	/* ------------------------- */
+	/* ---- MULTI-THREADING ---- */
+	/* ------------------------- */
+
+	namespace MT
+	{
+
+		// constructors
+		thread_pool::thread_pool(std::size_t nb_threads)
+			: m_queued(0), m_pending(0), m_next(0), m_stop(false)
+		{
+			// one thread per core by default (hardware_concurrency may return 0)
+			if(nb_threads == 0)
+				nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+			for(std::size_t i = 0; i < nb_threads; ++i)
+				m_queues.emplace_back(new worker_queue);
+
+			// the queues have to exist before starting the threads (they can steal from each other)
+			for(std::size_t i = 0; i < nb_threads; ++i)
+				m_threads.emplace_back(&thread_pool::run, this, i);
+		}
+
+
+
+		// destructor (waits for the remaining tasks)
+		thread_pool::~thread_pool()
+		{
+			wait();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_cv_task.notify_all();
+			for(std::size_t i = 0; i < m_threads.size(); ++i)
+				m_threads[i].join();
+		}
+
+
+
+		// access - general
+		std::size_t thread_pool::get_size() const
+		{
+			return m_threads.size();
+		}
+
+
+
+		// add a task to the queues
+		void thread_pool::submit(std::function<void()> task)
+		{
+			std::size_t index;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				index = m_next++ % m_queues.size(); // round robin on the workers
+				++m_pending;
+
+				std::lock_guard<std::mutex> lock_queue(m_queues[index]->mutex);
+				m_queues[index]->tasks.push_back(std::move(task));
+				++m_queued; // under m_mutex so that no worker misses the notification
+			}
+			m_cv_task.notify_one();
+		}
+
+
+		// blocks until all the submitted tasks are done
+		void thread_pool::wait()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv_done.wait(lock, [this]() { return m_pending == 0; });
+		}
+
+
+
+		// worker loop
+		void thread_pool::run(std::size_t index)
+		{
+			std::function<void()> task;
+			while(true)
+			{
+				if(pop(index, task))
+				{
+					// a task should not kill the worker (same error management as the rest of the project)
+					try
+					{
+						task();
+					}
+					catch(const char* msg)
+					{
+						PROJECT_LOG_ERROR(msg);
+					}
+					catch(const std::exception& e)
+					{
+						PROJECT_LOG_ERROR(e.what());
+					}
+					catch(...)
+					{
+						PROJECT_LOG_ERROR("Error: unknown exception in a task of the thread pool");
+					}
+					task = nullptr; // releases the captures before signaling
+
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if(--m_pending == 0)
+						m_cv_done.notify_all();
+				}
+				else
+				{
+					// nothing to do or to steal: sleep until a new task or the end
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_cv_task.wait(lock, [this]() { return m_stop || m_queued > 0; });
+					if(m_stop && m_queued == 0)
+						return;
+				}
+			}
+		}
+
+
+		// takes a task from its own queue, otherwise steals one
+		bool thread_pool::pop(std::size_t index, std::function<void()>& task)
+		{
+			std::size_t size = m_queues.size();
+			for(std::size_t i = 0; i < size; ++i)
+			{
+				worker_queue& queue = *m_queues[(index + i) % size];
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				if(!queue.tasks.empty())
+				{
+					// own queue: front (submission order) / other queue: back
+					if(i == 0)
+					{
+						task = std::move(queue.tasks.front());
+						queue.tasks.pop_front();
+					}
+					else
+					{
+						task = std::move(queue.tasks.back());
+						queue.tasks.pop_back();
+					}
+					--m_queued;
+					return true;
+				}
+			}
+			return false;
+		}
+
+	}
+
+}
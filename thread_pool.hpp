@@ -0,0 +1,91 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+// libs of the project
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "logger.hpp" // errors of the tasks
+
+namespace project
+{
+
+	/* ------------------------- */
+	/* ---- MULTI-THREADING ---- */
+	/* ------------------------- */
+
+	namespace MT
+	{
+
+		// work-stealing thread pool
+		// each worker has its own queue of tasks: it takes its tasks from the front of its queue
+		// (in submission order) and when it is empty, it steals from the back of the other queues.
+		// Tasks should be submitted from the most expensive to the cheapest one for a good balance.
+		class thread_pool
+		{
+		public:
+
+			// constructors
+			explicit thread_pool(std::size_t nb_threads = 0); // 0 means one thread per core
+
+			// destructor (waits for the remaining tasks)
+			~thread_pool();
+
+			// no copy
+			thread_pool(const thread_pool&) = delete;
+			thread_pool& operator=(const thread_pool&) = delete;
+
+			// access - general
+			std::size_t get_size() const; // number of threads
+
+			// add a task to the queues (can be called from a task)
+			void submit(std::function<void()> task);
+
+			// blocks until all the submitted tasks are done
+			void wait();
+
+
+		private:
+
+			// queue of one worker
+			struct worker_queue
+			{
+				std::mutex mutex;
+				std::deque<std::function<void()>> tasks;
+			};
+
+			// data members
+			std::vector<std::unique_ptr<worker_queue>> m_queues;
+			std::vector<std::thread> m_threads;
+
+			std::mutex m_mutex; // for the condition variables
+			std::condition_variable m_cv_task; // new task or stop
+			std::condition_variable m_cv_done; // all tasks done
+			std::atomic<std::size_t> m_queued; // tasks waiting in the queues
+			std::size_t m_pending; // tasks submitted and not finished (protected by m_mutex)
+			std::size_t m_next; // next queue for submission (protected by m_mutex)
+			bool m_stop;
+
+			// worker loop
+			void run(std::size_t index);
+
+			// takes a task from its own queue, otherwise steals one
+			bool pop(std::size_t index, std::function<void()>& task);
+		};
+
+	}
+
+}
+
+
+
+#endif
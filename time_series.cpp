@@ -12,16 +12,136 @@ namespace project
 	
 	namespace TS
 	{
+		
+		namespace
+		{
+			// number of non-empty lines in [first, last)
+			std::size_t count_rows(const char* first, const char* last)
+			{
+				std::size_t rows = 0;
+				while(first != last)
+				{
+					const char* eol = static_cast<const char*>(std::memchr(first, '\n', static_cast<std::size_t>(last - first)));
+					eol = eol ? eol : last;
+					rows += (first != eol && *first != '\r') ? 1 : 0;
+					first = (eol == last) ? last : eol + 1;
+				}
+				return rows;
+			}
+			
+			// beginning of the non empty line of index row in [first, last) (same lines as count_rows)
+			const char* find_row(const char* first, const char* last, std::size_t row)
+			{
+				while(first != last)
+				{
+					const char* eol = static_cast<const char*>(std::memchr(first, '\n', static_cast<std::size_t>(last - first)));
+					eol = eol ? eol : last;
+					if(first != eol && *first != '\r' && row-- == 0)
+						return first;
+					first = (eol == last) ? last : eol + 1;
+				}
+				return last;
+			}
+			
+			// year fractions of the lines [first, size) under a day-count policy (see TS::day_count), first >= 1
+			// the years of a non additive policy are computed from the first date (no accumulated rounding)
+			template<class Policy>
+			void tabulate_years(const day_t* days, std::size_t first, std::size_t size, double* years, double* periods)
+			{
+				for(std::size_t i = first; i < size; ++i)
+				{
+					periods[i] = Policy::year_fraction(days[i-1], days[i]);
+					years[i] = Policy::additive ? years[i-1] + periods[i] : Policy::year_fraction(days[0], days[i]);
+				}
+			}
+			
+			// parses the "date;value" lines of [first, last), returns the number of lines parsed before an error
+			std::size_t parse_rows(const char* first, const char* last, day_t* dates, double* values)
+			{
+				std::size_t rows = 0;
+				while(first != last)
+				{
+					// empty line
+					if(*first == '\n' || *first == '\r')
+					{
+						++first;
+						continue;
+					}
+					
+					const char* p = csv::parse_date(first, last, dates[rows]);
+					if(!p || p == last || *p != ';')
+						return rows;
+					p = csv::parse_double(p + 1, last, values[rows]);
+					if(!p)
+						return rows;
+					while(p != last && (*p == ' ' || *p == '\r'))
+						++p;
+					if(p != last && *p != '\n')
+						return rows;
+					
+					first = p;
+					++rows;
+				}
+				return rows;
+			}
+			
+			
+			// binary snapshot, in the byte order of the machine (checked when loading):
+			// header (64 bytes) | dates (size x int32) | padding to 8 bytes | values (size x double)
+			// the checksum covers the two columns (not the padding)
+			struct snapshot_header
+			{
+				char magic[8];
+				std::uint32_t version;
+				std::uint32_t byte_order;
+				std::uint64_t size;
+				std::uint64_t dates_offset;
+				std::uint64_t values_offset;
+				std::uint64_t checksum;
+				std::uint32_t flags;
+				std::uint32_t reserved[3];
+			};
+			static_assert(sizeof(snapshot_header) == 64, "snapshot header must be 64 bytes");
+			
+			const char snapshot_magic[8] = {'T', 'S', 'S', 'N', 'A', 'P', '\0', '\0'};
+			const std::uint32_t snapshot_version = 1;
+			const std::uint32_t snapshot_byte_order = 0x01020304;
+			const std::uint32_t snapshot_has_checksum = 1;
+			
+			bool is_snapshot(const char* data, std::size_t size)
+			{
+				return (size >= sizeof(snapshot_header)) && (std::memcmp(data, snapshot_magic, sizeof(snapshot_magic)) == 0);
+			}
+			
+			// FNV-1a on 64-bit words (the last bytes one by one)
+			std::uint64_t checksum(const char* data, std::size_t size, std::uint64_t hash = 14695981039346656037ULL)
+			{
+				const std::uint64_t prime = 1099511628211ULL;
+				std::size_t i = 0;
+				for(; i + 8 <= size; i += 8)
+				{
+					std::uint64_t word;
+					std::memcpy(&word, data + i, 8);
+					hash = (hash ^ word) * prime;
+				}
+				for(; i < size; ++i)
+					hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+				return hash;
+			}
+		}
+		
 
 		// constructors
 		// without loading the data
 		time_series::time_series(const std::string& name, std::size_t size)
-			: m_name(name), m_dates(size), m_values(size)
-		{}
+			: m_name(name), m_dates(size), m_values(size), m_accrual_rate(0.0), m_day_count(day_count::act_365)
+		{
+			update_columns();
+		}
 		
 		// directly from a csv file
 		time_series::time_series(const std::string& name, std::ifstream& csv_file)
-			: m_name(name)
+			: m_name(name), m_accrual_rate(0.0), m_day_count(day_count::act_365)
 		{
 			try
 			{
@@ -38,15 +158,22 @@ namespace project
 			catch(const char* msg)
 			{
 				// error messages
-				std::cerr << msg << std::endl;
-				std::cout << "Error: time_series object " << m_name << " was not initialized" << std::endl;
+				PROJECT_LOG_ERROR(msg);
+				PROJECT_LOG_ERROR("Error: time_series object " << m_name << " was not initialized");
 			}
 		}
 		
+		// from a file, memory-mapped and parsed in parallel
+		time_series::time_series(const std::string& name, const std::string& path, std::size_t nb_threads)
+			: m_name(name), m_accrual_rate(0.0), m_day_count(day_count::act_365)
+		{
+			load_from_file(path, nb_threads);
+		}
+		
 		//destructor
 		time_series::~time_series()
 		{
-			std::cout << "Deletion of time_series object " << get_name() << std::endl;
+			PROJECT_LOG_DEBUG("Deletion of time_series object " << get_name());
 		}
 		
 		// import data
@@ -59,8 +186,8 @@ namespace project
 				std::size_t csv_size = csv::count_lines(csv_file);
 				if(get_size() != csv_size)
 				{
-					std::cout << "Error: size of csv file (" << csv_size
-						<< ") do not match size of time_series object (" << get_size() << ")" << std::endl;
+					PROJECT_LOG_ERROR("Error: size of csv file (" << csv_size
+						<< ") do not match size of time_series object (" << get_size() << ")");
 				}
 				else
 				{
@@ -74,13 +201,13 @@ namespace project
 						if(!date.empty())
 						{
 							// storing the date
-							if(i == 0) // first date has some additionnal characters (pb of .csv file)
-								date = date.substr(3);
+							if(i == 0) // the file may start with a byte order mark
+								date = date.substr(csv::bom_size(date.data(), date.size()));
 							
-							m_dates[i] = to_date(date);
+							m_dates.mutable_data()[i] = to_days(date);
 							
 							// storing the value
-							m_values[i] = std::atof(value.c_str()); // convert string to double
+							m_values.mutable_data()[i] = std::atof(value.c_str()); // convert string to double
 							i++;
 						}
 					}
@@ -92,19 +219,216 @@ namespace project
 					}
 					catch(const char* msg)
 					{
-						std::cerr << msg << std::endl;
+						PROJECT_LOG_ERROR(msg);
+					}
+					
+					// the data changed: new derived columns
+					update_columns();
+				
+					PROJECT_LOG_INFO("Data successfully loaded into time_series object " << m_name);
+				}
+			}
+			catch(const char* msg)
+			{
+				PROJECT_LOG_ERROR(msg);
+				PROJECT_LOG_ERROR("Error: data not loaded in time_series object " << m_name);
+			}
+		}
+		
+		void time_series::load_from_file(const std::string& path, std::size_t nb_threads)
+		{
+			try
+			{
+				// mapped once: a snapshot is opened on the same mapping
+				std::shared_ptr<csv::mapped_file> file = std::make_shared<csv::mapped_file>(path);
+				if(is_snapshot(file->data(), file->size()))
+				{
+					open_snapshot(file, false);
+					PROJECT_LOG_INFO("Snapshot successfully loaded into time_series object " << m_name);
+					return;
+				}
+				const char* first = file->data() + csv::bom_size(file->data(), file->size());
+				const char* last = file->data() + file->size();
+				std::size_t length = static_cast<std::size_t>(last - first);
+				
+				// chunks of at least 1MB (small files are parsed by the calling thread)
+				const std::size_t min_chunk = std::size_t(1) << 20;
+				if(nb_threads == 0)
+					nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+				std::size_t nb_chunks = std::max(std::min(nb_threads, length / min_chunk), std::size_t(1));
+				
+				// the chunks end after a new line
+				std::vector<const char*> bounds(nb_chunks + 1, last);
+				bounds[0] = first;
+				for(std::size_t k = 1; k < nb_chunks; ++k)
+				{
+					const char* p = std::max(first + k * (length / nb_chunks), bounds[k - 1]);
+					const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(last - p)));
+					bounds[k] = eol ? eol + 1 : last;
+				}
+				
+				// 1. number of lines of each chunk, 2. parsing of each chunk at its position in the columns
+				std::vector<std::size_t> counts(nb_chunks), parsed(nb_chunks);
+				std::vector<std::size_t> offsets(nb_chunks + 1, 0);
+				auto for_each_chunk = [nb_chunks](const std::function<void(std::size_t)>& task)
+				{
+					if(nb_chunks == 1)
+					{
+						task(0);
+						return;
 					}
+					MT::thread_pool pool(nb_chunks);
+					for(std::size_t k = 0; k < nb_chunks; ++k)
+						pool.submit([&task, k]() { task(k); });
+					pool.wait();
+				};
+				
+				for_each_chunk([&](std::size_t k)
+				{
+					counts[k] = count_rows(bounds[k], bounds[k + 1]);
+				});
+				std::partial_sum(counts.begin(), counts.end(), offsets.begin() + 1);
+				
+				m_dates.resize(offsets[nb_chunks]);
+				m_values.resize(offsets[nb_chunks]);
+				day_t* dates = m_dates.mutable_data();
+				double* values = m_values.mutable_data();
+				for_each_chunk([&](std::size_t k)
+				{
+					parsed[k] = parse_rows(bounds[k], bounds[k + 1], dates + offsets[k], values + offsets[k]);
+				});
 				
-					std::cout << "Data successfully loaded into time_series object " << m_name << std::endl;
+				// first line that could not be parsed
+				for(std::size_t k = 0; k < nb_chunks; ++k)
+				{
+					if(parsed[k] != counts[k])
+					{
+						// line number in the file, empty lines included
+						const char* row = find_row(bounds[k], bounds[k + 1], parsed[k]);
+						std::size_t line = static_cast<std::size_t>(std::count(first, row, '\n')) + 1;
+						PROJECT_LOG_ERROR("Error: line " << line << " of file " << path
+								<< " is not a valid date;value line");
+						m_dates.clear();
+						m_values.clear();
+						update_columns();
+						throw "Error: invalid csv file!";
+					}
 				}
+				
+				// the data changed: new derived columns
+				update_columns();
+				
+				PROJECT_LOG_INFO("Data successfully loaded into time_series object " << m_name);
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
-				std::cout << "Error: data not loaded in time_series object " << m_name << std::endl;
+				PROJECT_LOG_ERROR(msg);
+				PROJECT_LOG_ERROR("Error: data not loaded in time_series object " << m_name);
 			}
 		}
 		
+		// binary snapshot
+		void time_series::save_snapshot(const std::string& path, bool checksum_on) const
+		{
+			std::size_t size = get_size();
+			snapshot_header header = {};
+			std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+			header.version = snapshot_version;
+			header.byte_order = snapshot_byte_order;
+			header.size = size;
+			header.dates_offset = sizeof(snapshot_header);
+			header.values_offset = (header.dates_offset + size * sizeof(day_t) + 7) / 8 * 8;
+			
+			const char* dates = reinterpret_cast<const char*>(m_dates.data());
+			const char* values = reinterpret_cast<const char*>(m_values.data());
+			if(checksum_on)
+			{
+				header.flags |= snapshot_has_checksum;
+				header.checksum = checksum(values, size * sizeof(double), checksum(dates, size * sizeof(day_t)));
+			}
+			
+			std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+			if(!file.is_open())
+			{
+				PROJECT_LOG_ERROR("Error: snapshot " << path << " of time_series object " << m_name << " could not be created");
+				return;
+			}
+			const char padding[8] = {};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(dates, static_cast<std::streamsize>(size * sizeof(day_t)));
+			file.write(padding, static_cast<std::streamsize>(header.values_offset - header.dates_offset - size * sizeof(day_t)));
+			file.write(values, static_cast<std::streamsize>(size * sizeof(double)));
+			
+			if(file.good())
+				PROJECT_LOG_INFO("time_series object " << m_name << " saved to " << path);
+			else
+				PROJECT_LOG_ERROR("Error: snapshot " << path << " of time_series object " << m_name << " could not be written");
+		}
+		
+		void time_series::load_snapshot(const std::string& path, bool verify_checksum)
+		{
+			try
+			{
+				open_snapshot(std::make_shared<csv::mapped_file>(path), verify_checksum);
+				PROJECT_LOG_INFO("Snapshot successfully loaded into time_series object " << m_name);
+			}
+			catch(const char* msg)
+			{
+				PROJECT_LOG_ERROR(msg);
+				PROJECT_LOG_ERROR("Error: data not loaded in time_series object " << m_name);
+			}
+		}
+		
+		// columns of the snapshot mapped in file (throws if it is not a valid snapshot)
+		void time_series::open_snapshot(std::shared_ptr<csv::mapped_file> file, bool verify_checksum)
+		{
+			const char* data = file->data();
+			if(!is_snapshot(data, file->size()))
+				throw "Error: not a time_series snapshot!";
+			
+			snapshot_header header;
+			std::memcpy(&header, data, sizeof(header));
+			if(header.byte_order != snapshot_byte_order)
+				throw "Error: snapshot written on a machine with another byte order!";
+			if(header.version != snapshot_version)
+				throw "Error: unsupported snapshot version!";
+			
+			// the columns have to be inside the file
+			std::uint64_t file_size = file->size();
+			std::uint64_t size = header.size;
+			if(   (size > file_size / sizeof(double))
+			   || (header.dates_offset > file_size - size * sizeof(day_t))
+			   || (header.values_offset > file_size - size * sizeof(double)))
+				throw "Error: truncated snapshot!";
+			
+			const char* dates = data + header.dates_offset;
+			const char* values = data + header.values_offset;
+			std::size_t n = static_cast<std::size_t>(size);
+			if(verify_checksum && (header.flags & snapshot_has_checksum)
+			   && (checksum(values, n * sizeof(double), checksum(dates, n * sizeof(day_t))) != header.checksum))
+				throw "Error: checksum of the snapshot does not match!";
+			
+			// the columns point into the mapped file, which stays alive as long as they do
+			// (copied if the file is not aligned, eg. not mapped)
+			if(   (reinterpret_cast<std::uintptr_t>(dates) % alignof(day_t) == 0)
+			   && (reinterpret_cast<std::uintptr_t>(values) % alignof(double) == 0))
+			{
+				m_dates.let_view(reinterpret_cast<const day_t*>(dates), n, file);
+				m_values.let_view(reinterpret_cast<const double*>(values), n, file);
+			}
+			else
+			{
+				m_dates.resize(n);
+				m_values.resize(n);
+				std::memcpy(m_dates.mutable_data(), dates, n * sizeof(day_t));
+				std::memcpy(m_values.mutable_data(), values, n * sizeof(double));
+			}
+			
+			// the data changed: new derived columns
+			update_columns();
+		}
+		
+		
 		// access - general
 		std::string time_series::get_name() const
 		{
@@ -118,12 +442,12 @@ namespace project
 		
 		struct std::tm time_series::date_start() const
 		{
-			return m_dates[0]; // returns the first date
+			return to_tm(m_dates[0]); // returns the first date
 		}
 		
 		struct std::tm time_series::date_end() const
 		{
-			return m_dates[get_size()-1]; // returns the last date
+			return to_tm(m_dates[get_size()-1]); // returns the last date
 		}
 		
 		
@@ -179,19 +503,18 @@ namespace project
 		
 		std::size_t time_series::get_index(struct std::tm tm) const
 		{
-			// to use the following find algorithm, we had to implement boolean operators for std::tm
-			auto pos = std::find(m_dates.cbegin(), m_dates.cend(), tm);
-			std::size_t index = std::distance(m_dates.cbegin(), pos) + 1;
-			if(is_line(index)) // if not means we didn't find
+			return get_index(to_days(tm));
+		}
+		
+		std::size_t time_series::get_index(day_t day) const
+		{
+			std::size_t index = find_index(day);
+			if(index == 0) // means we didn't find
 			{
-				return index;
+				PROJECT_LOG_ERROR("Error: date not found");
 			}
-			else
-			{
-				std::cout << "Error: date not found" << std::endl;
-				return 0;
-			}
-		} 
+			return index;
+		}
 		
 		
 		// acces - dates
@@ -199,17 +522,94 @@ namespace project
 		{
 			if(is_line(line))
 			{
-				return m_dates[line-1];
+				return to_tm(m_dates[line-1]);
 			}
 			else
 			{
 				// if the requested line is out of bounds
-				std::cout << "Bad std::tm return" << std::endl;
-				struct std::tm tm = {0,0,0,0,0,0,0,0,0};
+				PROJECT_LOG_ERROR("Bad std::tm return");
+				struct std::tm tm = {};
 				return tm;
 			}
 		}
 		
+		day_t time_series::get_day(std::size_t line) const
+		{
+			if(is_line(line))
+			{
+				return m_dates[line-1];
+			}
+			else
+			{
+				// if the requested line is out of bounds
+				return 0;
+			}
+		}
+		
+		
+		// access - columns
+		const column<day_t>& time_series::get_dates() const
+		{
+			return m_dates;
+		}
+		
+		const column<double>& time_series::get_values() const
+		{
+			return m_values;
+		}
+		
+		const std::vector<double>& time_series::get_years() const
+		{
+			return m_years;
+		}
+		
+		const std::vector<double>& time_series::get_returns() const
+		{
+			return m_returns;
+		}
+		
+		const std::vector<double>& time_series::get_log_returns() const
+		{
+			return m_log_returns;
+		}
+		
+		const std::vector<double>& time_series::get_accruals() const
+		{
+			return m_accruals;
+		}
+		
+		const std::vector<double>& time_series::get_periods() const
+		{
+			return m_periods;
+		}
+		
+		double time_series::get_accrual_rate() const
+		{
+			return m_accrual_rate;
+		}
+		
+		day_count time_series::get_day_count() const
+		{
+			return m_day_count;
+		}
+		
+		series_window time_series::window(std::size_t start, std::size_t end) const
+		{
+			series_window w = {start, end, {}, {}, {}, {}, {}, {}, {}};
+			if((start > end) || !is_line(start) || !is_line(end))
+				return w;
+			
+			std::size_t first = start - 1, size = end - start + 1;
+			w.dates = span<day_t>(m_dates.data() + first, size);
+			w.values = span<double>(m_values.data() + first, size);
+			w.years = span<double>(m_years.data() + first, size);
+			w.periods = span<double>(m_periods.data() + first, size);
+			w.returns = span<double>(m_returns.data() + first, size);
+			w.log_returns = span<double>(m_log_returns.data() + first, size);
+			w.accruals = span<double>(m_accruals.data() + first, size);
+			return w;
+		}
+		
 		
 		// returns the closest value (next value / previous value)
 		std::size_t time_series::approx_index(std::string date, bool next) const
@@ -218,25 +618,30 @@ namespace project
 		}		
 		
 		std::size_t time_series::approx_index(struct std::tm tm, bool next) const
+		{
+			return approx_index(to_days(tm), next);
+		}
+		
+		std::size_t time_series::approx_index(day_t day, bool next) const
 		{
 			// non-converging cases
-			if( ((next == true) & (tm > date_end())) | ((next == false) & (tm < date_start())) )
+			if( (get_size() == 0) || ((next == true) & (day > m_dates.back())) | ((next == false) & (day < m_dates.front())) )
 			{
-				std::cout << "Error: call out of bounds of time_series object " << m_name << std::endl;
+				PROJECT_LOG_ERROR("Error: call out of bounds of time_series object " << m_name);
 				return 0;
 			}
 			
 			// extreme cases
-			if(tm > date_end())
+			if(day > m_dates.back())
 				return get_size();
-			if(tm < date_start())
+			if(day < m_dates.front())
 				return 1;
 			
-			// general code
-			int incr = next ? 1 : -1; // increment positive if we want the next closest value
-			while(get_index(tm) == 0)
-				tm.tm_mday += incr;
-			return get_index(tm);
+			// general code: first line of the closest date after (or before) the day, by binary search
+			std::size_t rank = lower_rank(day);
+			if(!next && sorted_day(rank) != day)
+				rank = lower_rank(sorted_day(rank - 1));
+			return sorted_line(rank);
 		}
 		
 		
@@ -244,7 +649,7 @@ namespace project
 		// returns the index n months before / after
 		std::size_t time_series::shift_months(std::size_t line, int n, bool after, bool next) const
 		{
-			return shift_months(m_dates[line-1], n, after, next);
+			return shift_months(get_date(line), n, after, next);
 		}
 		
 		std::size_t time_series::shift_months(std::string date, int n, bool after, bool next) const
@@ -263,7 +668,7 @@ namespace project
 		// returns the index n days before / after
 		std::size_t time_series::shift_days(std::size_t line, int n, bool after, bool next) const
 		{
-			return shift_days(m_dates[line-1], n, after, next);
+			return shift_days(get_date(line), n, after, next);
 		}
 		
 		std::size_t time_series::shift_days(std::string date, int n, bool after, bool next) const
@@ -275,8 +680,7 @@ namespace project
 		{
 			// if we want the date after then we will do +n otherwise -n
 			int incr = after ? 1 : -1;
-			tm.tm_mday += n * incr; // same principle as for months but with days
-			return approx_index(tm, next);
+			return approx_index(to_days(tm) + n * incr, next); // same principle as for months but with days
 		}
 		
 		
@@ -285,10 +689,82 @@ namespace project
 		void time_series::let_name(std::string name)
 		{
 			// let_name is used by other classes: hedged_ptf and vol_surface
-			std::cout << "time_series object " << m_name << " renamed " << name << std::endl;
+			PROJECT_LOG_DEBUG("time_series object " << m_name << " renamed " << name);
 			m_name = name; 
 		}
 		
+		void time_series::let_accrual_rate(double rate)
+		{
+			// only recomputed if the rate actually changes
+			if(rate != m_accrual_rate)
+			{
+				m_accrual_rate = rate;
+				update_accruals();
+			}
+		}
+		
+		void time_series::let_day_count(day_count convention)
+		{
+			if(convention != m_day_count)
+			{
+				m_day_count = convention;
+				update_years(1);
+				update_accruals();
+			}
+		}
+		
+		
+		// adds a new observation after the last one
+		bool time_series::append(day_t day, double value)
+		{
+			std::size_t size = get_size();
+			if((size > 0) && (day <= m_dates.back()))
+			{
+				PROJECT_LOG_ERROR("Error: appended date " << to_string(to_tm(day)) << " is not after the last date of time_series object "
+						<< m_name << " (" << to_string(to_tm(m_dates.back())) << ")");
+				return false;
+			}
+			
+			m_dates.push_back(day);
+			m_values.push_back(value);
+			
+			// unsorted dates: the new line is inserted in the date index (after the lines of its day)
+			if(!m_date_order.empty())
+			{
+				auto pos = std::upper_bound(m_date_order.cbegin(), m_date_order.cend(), day, [this](day_t d, std::size_t line)
+				{
+					return d < m_dates[line];
+				});
+				m_date_order.insert(m_date_order.begin() + (pos - m_date_order.cbegin()), size);
+			}
+			
+			// derived columns: same formulas as update_columns and update_accruals, for the new line only
+			if(size == 0)
+			{
+				update_columns();
+				return true;
+			}
+			double previous = m_values[size - 1];
+			bool positive = (previous > 0.0) & (value > 0.0);
+			m_years.push_back(0.0);
+			m_periods.push_back(0.0);
+			update_years(size);
+			m_returns.push_back(positive ? (value - previous) / previous : 0.0);
+			m_log_returns.push_back(positive ? std::log(value / previous) : 0.0);
+			m_accruals.push_back(std::exp(m_accrual_rate * m_periods[size]) - 1.0);
+			return true;
+		}
+		
+		bool time_series::append(std::string date, double value)
+		{
+			return append(to_days(date), value);
+		}
+		
+		bool time_series::append(struct std::tm tm, double value)
+		{
+			return append(to_days(tm), value);
+		}
+		
 		
 		
 		
@@ -301,7 +777,7 @@ namespace project
 		{
 			if(is_line(line))
 			{
-				std::cout << line << " - " << to_string(m_dates[line-1])
+				std::cout << line << " - " << to_string(to_tm(m_dates[line-1]))
 						<< " - " << m_values[line-1] << std::endl;
 			}
 			// error message is printed through is_line if line out of bounds
@@ -309,8 +785,10 @@ namespace project
 		
 		void time_series::print_data() const
 		{
-			for(std::size_t i = 1; i <= get_size(); ++i)
-				print_line(i);
+			// same format as print_line, the bounds are checked once
+			series_window w = window(1, get_size());
+			for(std::size_t i = 0; i < w.size(); ++i)
+				std::cout << i + 1 << " - " << to_string(to_tm(w.dates[i])) << " - " << w.values[i] << std::endl;
 		}
 		
 		
@@ -348,7 +826,7 @@ namespace project
 		{
 			if((line > get_size()) || (line <= 0))
 			{
-				std::cout << "Error: call out of bounds of time_series object " << m_name << std::endl;
+				PROJECT_LOG_ERROR("Error: call out of bounds of time_series object " << m_name);
 				return false;
 			}
 			else
@@ -356,6 +834,117 @@ namespace project
 				return true;
 			}
 		}
+		
+		// computes the derived columns (called each time the data changes)
+		void time_series::update_columns()
+		{
+			std::size_t size = get_size();
+			update_date_order();
+			m_years.assign(size, 0.0);
+			m_periods.assign(size, 0.0);
+			m_returns.assign(size, 0.0);
+			m_log_returns.assign(size, 0.0);
+			update_years(1);
+			
+			for(std::size_t i = 1; i < size; ++i)
+			{
+				// returns (left to 0 on non-positive values, eg. not loaded data)
+				if((m_values[i-1] > 0.0) & (m_values[i] > 0.0))
+				{
+					m_returns[i] = (m_values[i] - m_values[i-1]) / m_values[i-1];
+					m_log_returns[i] = std::log(m_values[i] / m_values[i-1]);
+				}
+			}
+			
+			update_accruals();
+		}
+		
+		void time_series::update_years(std::size_t first)
+		{
+			// the convention is resolved once for the whole column
+			const day_t* days = m_dates.data();
+			std::size_t size = get_size();
+			switch(m_day_count)
+			{
+				case day_count::act_360:
+					tabulate_years<act_360>(days, first, size, m_years.data(), m_periods.data());
+					break;
+				case day_count::act_act:
+					tabulate_years<act_act>(days, first, size, m_years.data(), m_periods.data());
+					break;
+				case day_count::bus_252:
+					tabulate_years<bus_252>(days, first, size, m_years.data(), m_periods.data());
+					break;
+				default:
+					tabulate_years<act_365>(days, first, size, m_years.data(), m_periods.data());
+			}
+		}
+		
+		void time_series::update_accruals()
+		{
+			std::size_t size = get_size();
+			m_accruals.assign(size, 0.0);
+			
+			// growth of one unit of cash invested at the risk-free rate between two lines
+			for(std::size_t i = 1; i < size; ++i)
+				m_accruals[i] = std::exp(m_accrual_rate * m_periods[i]) - 1.0;
+		}
+		
+		
+		// index of a day number, 0 if not found (no error message)
+		// first line of the day (binary search in the sorted dates)
+		std::size_t time_series::find_index(day_t day) const
+		{
+			std::size_t rank = lower_rank(day);
+			if((rank < get_size()) && (sorted_day(rank) == day))
+			{
+				return sorted_line(rank);
+			}
+			else
+			{
+				return 0;
+			}
+		}
+		
+		
+		// sorted dates: the column itself if it is sorted (the usual case), otherwise through m_date_order
+		void time_series::update_date_order()
+		{
+			m_date_order.clear();
+			if(std::is_sorted(m_dates.cbegin(), m_dates.cend()))
+				return;
+			
+			// stable: the lines of a same day stay in order (the first one is found first)
+			m_date_order.resize(get_size());
+			std::iota(m_date_order.begin(), m_date_order.end(), std::size_t(0));
+			std::stable_sort(m_date_order.begin(), m_date_order.end(), [this](std::size_t a, std::size_t b)
+			{
+				return m_dates[a] < m_dates[b];
+			});
+			PROJECT_LOG_DEBUG("Dates of time_series object " << m_name << " are not sorted: date index built");
+		}
+		
+		std::size_t time_series::lower_rank(day_t day) const
+		{
+			if(m_date_order.empty())
+				return static_cast<std::size_t>(std::lower_bound(m_dates.cbegin(), m_dates.cend(), day) - m_dates.cbegin());
+			
+			auto pos = std::lower_bound(m_date_order.cbegin(), m_date_order.cend(), day, [this](std::size_t line, day_t d)
+			{
+				return m_dates[line] < d;
+			});
+			return static_cast<std::size_t>(pos - m_date_order.cbegin());
+		}
+		
+		day_t time_series::sorted_day(std::size_t rank) const
+		{
+			return m_date_order.empty() ? m_dates[rank] : m_dates[m_date_order[rank]];
+		}
+		
+		std::size_t time_series::sorted_line(std::size_t rank) const
+		{
+			return (m_date_order.empty() ? rank : m_date_order[rank]) + 1;
+		}
 	}
 	
 	
@@ -5,17 +5,22 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "functions.hpp" // day numbers
+#include "thread_pool.hpp" // parallel loading
+
 namespace project
 {
 	
@@ -27,6 +32,111 @@ namespace project
 	namespace TS
 	{
 		
+		// column of a time_series: either owns its elements, or is a view on elements owned by another object
+		// (eg. the pages of a mapped snapshot, kept alive by the column). A view is copied before any modification.
+		template<typename T>
+		class column
+		{
+		public:
+			
+			// constructors
+			explicit column(std::size_t size = 0) : m_owned(size), p_view(nullptr), m_view_size(0) {}
+			
+			// view on the elements [data, data + size) of owner (no copy)
+			void let_view(const T* data, std::size_t size, std::shared_ptr<const void> owner)
+			{
+				m_owned.clear();
+				m_owned.shrink_to_fit();
+				p_view = data;
+				m_view_size = size;
+				m_owner = std::move(owner);
+			}
+			
+			// access
+			bool is_view() const { return static_cast<bool>(m_owner); }
+			std::size_t size() const { return is_view() ? m_view_size : m_owned.size(); }
+			bool empty() const { return size() == 0; }
+			
+			const T* data() const { return is_view() ? p_view : m_owned.data(); }
+			const T& operator[](std::size_t i) const { return data()[i]; }
+			const T& front() const { return data()[0]; }
+			const T& back() const { return data()[size() - 1]; }
+			const T* begin() const { return data(); }
+			const T* end() const { return data() + size(); }
+			const T* cbegin() const { return begin(); }
+			const T* cend() const { return end(); }
+			
+			// modify (a view becomes a copy)
+			T* mutable_data() { own(); return m_owned.data(); }
+			void push_back(const T& value) { own(); m_owned.push_back(value); }
+			void resize(std::size_t size) { own(); m_owned.resize(size); }
+			void clear() { own(); m_owned.clear(); }
+			
+		private:
+			
+			std::vector<T> m_owned;
+			const T* p_view;
+			std::size_t m_view_size;
+			std::shared_ptr<const void> m_owner; // keeps the viewed elements alive (empty if owned)
+			
+			void own()
+			{
+				if(is_view())
+				{
+					m_owned.assign(p_view, p_view + m_view_size);
+					p_view = nullptr;
+					m_view_size = 0;
+					m_owner.reset();
+				}
+			}
+		};
+		
+		// read-only view of contiguous elements (a window of a column), without copy
+		template<typename T>
+		class span
+		{
+		public:
+			
+			// constructors
+			span() : p_data(nullptr), m_size(0) {}
+			span(const T* data, std::size_t size) : p_data(data), m_size(size) {}
+			
+			// access
+			std::size_t size() const { return m_size; }
+			bool empty() const { return m_size == 0; }
+			const T* data() const { return p_data; }
+			const T& operator[](std::size_t i) const { return p_data[i]; }
+			const T& front() const { return p_data[0]; }
+			const T& back() const { return p_data[m_size - 1]; }
+			const T* begin() const { return p_data; }
+			const T* end() const { return p_data + m_size; }
+			
+		private:
+			
+			const T* p_data;
+			std::size_t m_size;
+		};
+		
+		// lines [start, end] of a time_series (base 1, as operator[]): its columns without copy, index 0 is the
+		// line start, so that a loop on a range checks its bounds once instead of once per element
+		// valid until the series changes (append, load, let_accrual_rate, let_day_count)
+		struct series_window
+		{
+			std::size_t start;
+			std::size_t end;
+			span<day_t> dates;
+			span<double> values;
+			span<double> years;
+			span<double> periods;
+			span<double> returns;
+			span<double> log_returns;
+			span<double> accruals;
+			
+			std::size_t size() const { return dates.size(); }
+			bool empty() const { return dates.empty(); }
+		};
+		
+		
 		class time_series
 		{
 		public:
@@ -34,12 +144,22 @@ namespace project
 			// constructors
 			time_series(const std::string& name, std::size_t size); // without loading the data
 			time_series(const std::string& name, std::ifstream& csv_file); // directly from a csv file
+			time_series(const std::string& name, const std::string& path, std::size_t nb_threads = 0); // csv or snapshot file
 			
 			// destructor
 			~time_series();
 			
 			// import data
 			void load_from_csv(std::ifstream& csv_file);
+			// memory-mapped file split in chunks parsed in parallel (0: one thread per core), resizes the series
+			// binary snapshots (see save_snapshot) are recognized and opened with load_snapshot
+			void load_from_file(const std::string& path, std::size_t nb_threads = 0);
+			
+			// binary snapshot: header, date column, value column and optional checksum (see time_series.cpp)
+			// the columns of a loaded snapshot point into the mapped file (no copy, the pages are shared
+			// between the processes opening the same file); they are copied only if the data is modified
+			void save_snapshot(const std::string& path, bool checksum = true) const;
+			void load_snapshot(const std::string& path, bool verify_checksum = false);
 			
 			
 			// access - general
@@ -58,14 +178,33 @@ namespace project
 			// access - index
 			std::size_t get_index(std::string date) const;
 			std::size_t get_index(struct std::tm tm) const;
+			std::size_t get_index(day_t day) const;
 			
 			// acces - dates
 			struct std::tm get_date(std::size_t line) const;
+			day_t get_day(std::size_t line) const; // day number (no conversion)
+			
+			
+			// access - columns (base 0, unlike operator[])
+			// derived columns are computed once when the data changes, and accruals when the rate changes
+			const column<day_t>& get_dates() const; // day numbers
+			const column<double>& get_values() const;
+			const std::vector<double>& get_years() const; // cumulative year fractions from the first date (see get_day_count)
+			const std::vector<double>& get_periods() const; // year fractions from the previous line (first element is 0)
+			const std::vector<double>& get_returns() const; // simple returns (first element is 0)
+			const std::vector<double>& get_log_returns() const; // log returns (first element is 0)
+			const std::vector<double>& get_accruals() const; // exp(rate * dt) - 1 from the previous line (first element is 0)
+			double get_accrual_rate() const;
+			day_count get_day_count() const;
+			
+			// access - window of lines [start, end] (base 1), empty if out of bounds (checked once)
+			series_window window(std::size_t start, std::size_t end) const;
 			
 			
 			// returns the closest value (next value / previous value)
 			std::size_t approx_index(std::string date, bool next = true) const;
 			std::size_t approx_index(struct std::tm tm, bool next = true) const;
+			std::size_t approx_index(day_t day, bool next = true) const;
 			
 			// returns the index n periods before / after
 			// ex for getting the last 3M period for computing vol:
@@ -82,6 +221,13 @@ namespace project
 			
 			// modify - general
 			void let_name(std::string name);
+			void let_accrual_rate(double rate); // recomputes the accruals column
+			void let_day_count(day_count convention); // recomputes the years, periods and accruals columns (ACT/365 by default)
+			
+			// adds a new observation after the last one (amortized constant time, the derived columns are extended)
+			bool append(day_t day, double value); // false if the date is not after the last one
+			bool append(std::string date, double value);
+			bool append(struct std::tm tm, double value);
 			
 			
 			
@@ -97,13 +243,41 @@ namespace project
 			
 			// data members
 			std::string m_name;
-			std::vector<struct std::tm> m_dates;
-			std::vector<double> m_values;
+			column<day_t> m_dates; // day numbers (see TS::to_days)
+			column<double> m_values;
+			
+			// derived columns
+			std::vector<double> m_years;
+			std::vector<double> m_periods;
+			std::vector<double> m_returns;
+			std::vector<double> m_log_returns;
+			std::vector<double> m_accruals;
+			double m_accrual_rate;
+			day_count m_day_count;
+			
+			// computes the derived columns (called each time the data changes)
+			void update_columns();
+			void update_years(std::size_t first); // lines from first (base 0, at least 1)
+			void update_accruals();
+			
+			// columns of a mapped snapshot (see load_snapshot), throws if it is not valid
+			void open_snapshot(std::shared_ptr<csv::mapped_file> file, bool verify_checksum);
 			
 			
 			// check line
 			bool is_line(std::size_t line) const;
 			
+			// index of a day number, 0 if not found (no error message)
+			std::size_t find_index(day_t day) const;
+			
+			// date index: lines sorted by date (base 0), empty when m_dates is already sorted
+			// every date lookup is a binary search on the sorted dates (see find_index and approx_index)
+			std::vector<std::size_t> m_date_order;
+			void update_date_order(); // called with update_columns
+			std::size_t lower_rank(day_t day) const; // number of dates before day
+			day_t sorted_day(std::size_t rank) const;
+			std::size_t sorted_line(std::size_t rank) const; // base 1
+			
 		};
 		
 	}
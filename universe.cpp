@@ -0,0 +1,494 @@
+#include "time_series.hpp"
+#include "hedged_ptf.hpp"
+#include "functions.hpp"
+#include "surface_file.hpp"
+#include "vol_surface.hpp"
+#include "universe.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace project
+{
+	
+	namespace VS
+	{
+		
+		namespace
+		{
+			// directory of a path (with its trailing separator, empty for a file of the working directory)
+			std::string parent_directory(const std::string& path)
+			{
+				std::size_t pos = path.find_last_of("/\\");
+				return (pos == std::string::npos) ? std::string() : path.substr(0, pos + 1);
+			}
+			
+			// name of a file without its directory and its extension
+			std::string file_stem(const std::string& path)
+			{
+				std::size_t pos = path.find_last_of("/\\");
+				std::string name = (pos == std::string::npos) ? path : path.substr(pos + 1);
+				std::size_t dot = name.find_last_of('.');
+				return (dot == std::string::npos || dot == 0) ? name : name.substr(0, dot);
+			}
+			
+			std::string trim(const std::string& s)
+			{
+				std::size_t first = s.find_first_not_of(" \t\r\n");
+				if(first == std::string::npos)
+					return std::string();
+				std::size_t last = s.find_last_not_of(" \t\r\n");
+				return s.substr(first, last - first + 1);
+			}
+			
+			// size of a file in bytes (0 if it cannot be opened)
+			std::size_t file_size(const std::string& path)
+			{
+				std::ifstream file(path, std::ios::binary | std::ios::ate);
+				if(!file.is_open())
+					return 0;
+				std::streamoff size = file.tellg();
+				return (size > 0) ? static_cast<std::size_t>(size) : 0;
+			}
+		}
+		
+		
+		
+		/* ---------------------------------- */
+		/* ---- UNIVERSE OF UNDERLYINGS ---- */
+		/* ---------------------------------- */
+		
+		// constructors
+		universe::universe(std::vector<double> maturities, std::vector<double> strikes)
+			: m_strikes(strikes), m_maturities(maturities), m_memory_budget(0), m_rate(0.01), m_accuracy(BS::accuracy::full), m_robust_pnl(false)
+		{
+		}
+		
+		
+		
+		// destructor
+		universe::~universe()
+		{
+			PROJECT_LOG_DEBUG("Deletion of universe object (" << get_size() << " underlyings)");
+		}
+		
+		
+		
+		
+		// access - data members
+		std::size_t universe::get_size() const
+		{
+			return m_entries.size();
+		}
+		
+		const std::vector<universe_entry>& universe::get_entries() const
+		{
+			return m_entries;
+		}
+		
+		const std::vector<double>& universe::get_strikes() const
+		{
+			return m_strikes;
+		}
+		
+		const std::vector<double>& universe::get_maturities() const
+		{
+			return m_maturities;
+		}
+		
+		std::size_t universe::get_memory_budget() const
+		{
+			return m_memory_budget;
+		}
+		
+		double universe::get_rate() const
+		{
+			return m_rate;
+		}
+		
+		BS::accuracy universe::get_accuracy() const
+		{
+			return m_accuracy;
+		}
+		
+		const std::vector<double>& universe::get_vols() const
+		{
+			return m_vols;
+		}
+		
+		vol_view universe::get_surface(std::size_t k) const
+		{
+			std::size_t ncells = m_strikes.size() * m_maturities.size();
+			if((k + 1) * ncells > m_vols.size())
+			{
+				PROJECT_LOG_ERROR("Error: underlying " << k << " out of the last run of the universe");
+				return vol_view();
+			}
+			return vol_view(m_vols.data() + k * ncells, ncells);
+		}
+		
+		vol_view universe::get_cell(double strike, double maturity) const
+		{
+			std::size_t j = static_cast<std::size_t>(std::find(m_strikes.cbegin(), m_strikes.cend(), strike) - m_strikes.cbegin());
+			std::size_t i = static_cast<std::size_t>(std::find(m_maturities.cbegin(), m_maturities.cend(), maturity) - m_maturities.cbegin());
+			std::size_t ncells = m_strikes.size() * m_maturities.size();
+			if((j == m_strikes.size()) || (i == m_maturities.size()) || m_vols.empty())
+			{
+				PROJECT_LOG_ERROR("Error: cell (" << strike << ", " << maturity << ") not in the last run of the universe");
+				return vol_view();
+			}
+			return vol_view(m_vols.data() + i * m_strikes.size() + j, m_vols.size() / ncells, ncells);
+		}
+		
+		
+		
+		
+		// modify - underlyings
+		void universe::add(const std::string& name, const std::string& path)
+		{
+			m_entries.push_back(universe_entry {name, path});
+			PROJECT_LOG_DEBUG("Underlying " << name << " (" << path << ") added to universe");
+		}
+		
+		std::size_t universe::add_directory(const std::string& dir)
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			DIR* handle = opendir(dir.c_str());
+			if(handle == nullptr)
+			{
+				PROJECT_LOG_ERROR("Error: directory " << dir << " could not be opened");
+				return 0;
+			}
+			
+			// regular files only, sorted by name (readdir gives no order)
+			std::string prefix = (dir.empty() || dir.back() == '/') ? dir : dir + '/';
+			std::vector<std::string> files;
+			while(struct dirent* item = readdir(handle))
+			{
+				std::string file = item->d_name;
+				struct stat info;
+				if(file[0] != '.' && stat((prefix + file).c_str(), &info) == 0 && S_ISREG(info.st_mode))
+					files.push_back(file);
+			}
+			closedir(handle);
+			std::sort(files.begin(), files.end());
+			
+			for(const std::string& file : files)
+				add(file_stem(file), prefix + file);
+			PROJECT_LOG_INFO(files.size() << " underlyings added to universe from directory " << dir);
+			return files.size();
+#else
+			PROJECT_LOG_ERROR("Error: directory " << dir << " could not be listed on this platform (use a manifest)");
+			return 0;
+#endif
+		}
+		
+		std::size_t universe::add_manifest(const std::string& path)
+		{
+			std::ifstream file(path);
+			if(!file.is_open())
+			{
+				PROJECT_LOG_ERROR("Error: manifest " << path << " could not be opened");
+				return 0;
+			}
+			
+			// "name;path" lines, the paths are relative to the manifest (empty lines and # comments are skipped)
+			std::string dir = parent_directory(path);
+			std::string line;
+			std::size_t count = 0, number = 0;
+			while(std::getline(file, line))
+			{
+				++number;
+				line = trim(line);
+				if(line.empty() || line[0] == '#')
+					continue;
+				std::size_t sep = line.find(';');
+				std::string name = trim(line.substr(0, sep));
+				std::string data = (sep == std::string::npos) ? std::string() : trim(line.substr(sep + 1));
+				if(name.empty() || data.empty())
+				{
+					PROJECT_LOG_ERROR("Error: line " << number << " of manifest " << path << " is not a valid name;path line");
+					continue;
+				}
+				bool absolute = (data[0] == '/') || (data[0] == '\\') || (data.size() > 1 && data[1] == ':');
+				add(name, absolute ? data : dir + data);
+				++count;
+			}
+			PROJECT_LOG_INFO(count << " underlyings added to universe from manifest " << path);
+			return count;
+		}
+		
+		void universe::clear()
+		{
+			m_entries.clear();
+			m_vols.clear();
+			m_as_of.clear();
+			m_loaded.clear();
+		}
+		
+		
+		
+		// modify - parameters
+		void universe::let_memory_budget(std::size_t bytes)
+		{
+			m_memory_budget = bytes;
+			PROJECT_LOG_DEBUG("Memory budget of universe set to " << bytes << " bytes");
+		}
+		
+		void universe::let_rate(double rate)
+		{
+			m_rate = rate;
+			PROJECT_LOG_DEBUG("Rate of universe set to " << rate);
+		}
+		
+		void universe::let_accuracy(BS::accuracy acc)
+		{
+			m_accuracy = acc;
+		}
+		
+		
+		
+		
+		// computations
+		std::size_t universe::run(const std::string& path, bool robust_pnl, std::size_t nb_threads)
+		{
+			MT::thread_pool pool(nb_threads);
+			return run(pool, path, robust_pnl);
+		}
+		
+		std::size_t universe::run(MT::thread_pool& pool, const std::string& path, bool robust_pnl)
+		{
+			std::size_t nstrikes = m_strikes.size(), nmaturities = m_maturities.size();
+			std::size_t ncells = nstrikes * nmaturities;
+			m_vols.assign(m_entries.size() * ncells, std::numeric_limits<double>::quiet_NaN());
+			m_as_of.assign(m_entries.size(), 0);
+			m_loaded.assign(m_entries.size(), 0);
+			m_robust_pnl = robust_pnl;
+			
+			// maturities from the longest to the shortest (the longest cells are submitted first)
+			std::vector<std::size_t> order(nmaturities);
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b)
+			{
+				return m_maturities[a] > m_maturities[b];
+			});
+			
+			// memory in flight, released with each underlying
+			std::mutex mutex;
+			std::condition_variable cv_release;
+			std::size_t in_flight = 0, bytes_in_flight = 0;
+			std::atomic<std::size_t> loaded(0);
+			auto release = [&](std::size_t bytes)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--in_flight;
+				bytes_in_flight -= bytes;
+				cv_release.notify_all();
+			};
+			
+			// an underlying in flight: owned by its loading task and its cells, the last of them to finish frees it
+			// and gives its memory back to the budget, whatever the way the tasks end (errors, exceptions)
+			struct job
+			{
+				std::function<void()> release;
+				std::unique_ptr<BS::hedged_ptf> ptf;
+				std::vector<std::shared_ptr<const BS::hedge_schedule>> schedules;
+				
+				~job()
+				{
+					// freed before the next underlying is admitted
+					schedules.clear();
+					ptf.reset();
+					release();
+				}
+			};
+			
+			for(std::size_t k = 0; k < m_entries.size(); ++k)
+			{
+				// the next underlying waits until it fits in the budget (it is always admitted alone)
+				std::size_t bytes = estimate_memory(m_entries[k]);
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					cv_release.wait(lock, [&]()
+					{
+						return (m_memory_budget == 0) || (in_flight == 0) || (bytes_in_flight + bytes <= m_memory_budget);
+					});
+					++in_flight;
+					bytes_in_flight += bytes;
+				}
+				
+				std::shared_ptr<job> current = std::make_shared<job>();
+				current->release = [&release, bytes]() { release(bytes); };
+				
+				// one task loads the underlying (on one thread) and submits its cells
+				const universe_entry* entry = &m_entries[k];
+				double* vols = m_vols.data() + k * ncells;
+				std::int32_t* as_of = &m_as_of[k];
+				unsigned char* is_loaded = &m_loaded[k];
+				pool.submit([this, &pool, &loaded, &order, current, entry, vols, as_of, is_loaded, nstrikes, robust_pnl]()
+				{
+					try
+					{
+						current->ptf.reset(new BS::hedged_ptf(entry->name, entry->path, 100.0, m_rate, 0.0, 1));
+						current->ptf->let_accuracy(m_accuracy);
+					}
+					catch(const char* msg)
+					{
+						PROJECT_LOG_ERROR(msg);
+					}
+					if(!current->ptf || current->ptf->get_ts().get_size() < 2)
+					{
+						PROJECT_LOG_ERROR("Error: underlying " << entry->name << " (" << entry->path << ") skipped");
+						return;
+					}
+					++loaded;
+					
+					// ranges of the last months that fit in the data (the other cells are left empty)
+					const BS::hedged_ptf& ptf = *current->ptf;
+					const TS::time_series& ts = ptf.get_ts();
+					std::size_t end = ts.get_size();
+					*as_of = ts.get_day(end);
+					*is_loaded = 1;
+					std::vector<std::size_t> maturities;
+					for(std::size_t i : order)
+					{
+						struct std::tm tm = ts.get_date(end);
+						tm.tm_mon -= static_cast<int>(m_maturities[i]);
+						if(TS::to_days(tm) < ts.get_day(1))
+							continue;
+						std::size_t start = ptf.get_last_start(static_cast<std::size_t>(m_maturities[i]));
+						if(start >= end) // a gap of more than the maturity at the end of the data
+							continue;
+						current->schedules.push_back(std::make_shared<const BS::hedge_schedule>(ptf, start, end));
+						maturities.push_back(i);
+					}
+					if(maturities.empty())
+					{
+						PROJECT_LOG_WARNING("Underlying " << entry->name << " is too short for the maturities of the universe");
+						return;
+					}
+					
+					// one task per cell, the schedule of a range is shared by the strikes of its maturity
+					for(std::size_t m = 0; m < maturities.size(); ++m)
+					{
+						const BS::hedge_schedule* schedule = current->schedules[m].get();
+						double spot = ts[schedule->get_start()];
+						for(std::size_t j = 0; j < nstrikes; ++j)
+						{
+							double strike = m_strikes[j] * spot / 100.0;
+							double* vol = vols + maturities[m] * nstrikes + j;
+							pool.submit([current, schedule, strike, vol, robust_pnl]()
+							{
+								BS::solver_result result = current->ptf->solve_implied_vol(*schedule, strike, robust_pnl);
+								if(!result.converged)
+								{
+									PROJECT_LOG_WARNING("Solver for implied vol did not converge in " << result.iterations
+											<< " iterations (" << current->ptf->get_name() << ")");
+									result.vol = 0;
+								}
+								*vol = result.vol;
+							});
+						}
+					}
+				});
+			}
+			pool.wait();
+			
+			export_to_csv(path);
+			std::string method = robust_pnl ? " (using Black-Scholes Robustness formula)" : "";
+			PROJECT_LOG_INFO("universe: " << loaded << " of " << m_entries.size() << " surfaces computed" << method);
+			return loaded;
+		}
+		
+		
+		
+		// the series and its derived columns (dates, values, years, periods, returns, log returns and accruals),
+		// and the schedules of the ranges (nine columns, about 23 business days per month)
+		// the number of rows is bounded by the file size: a csv line or a snapshot row takes at least 12 bytes
+		std::size_t universe::estimate_memory(const universe_entry& entry) const
+		{
+			std::size_t rows = file_size(entry.path) / 12;
+			std::size_t bytes = rows * (sizeof(TS::day_t) + 6 * sizeof(double));
+			for(double maturity : m_maturities)
+			{
+				std::size_t range = std::min(rows, static_cast<std::size_t>(23.0 * maturity) + 1);
+				bytes += range * 9 * sizeof(double);
+			}
+			return bytes;
+		}
+		
+		
+		
+		// binary export: one surface per underlying loaded (see VS::surface_writer)
+		void universe::export_to_binary(const std::string& path, bool append) const
+		{
+			try
+			{
+				surface_writer writer(path, append);
+				std::size_t ncells = m_strikes.size() * m_maturities.size();
+				for(std::size_t k = 0; k < m_entries.size(); ++k)
+				{
+					if(m_loaded[k])
+						writer.write(m_entries[k].name, m_strikes, m_maturities, m_vols.data() + k * ncells, m_robust_pnl, m_as_of[k]);
+				}
+			}
+			catch(const char* msg)
+			{
+				PROJECT_LOG_ERROR(msg);
+				PROJECT_LOG_ERROR("Error: universe not exported to " << path);
+			}
+		}
+		
+		
+		
+		// export: one line per underlying, one column per cell (maturity, strike), empty cells are not computed
+		void universe::export_to_csv(const std::string& path) const
+		{
+			std::ofstream file(path);
+			if(!file.is_open())
+			{
+				PROJECT_LOG_ERROR("Error: universe file " << path << " could not be created");
+				return;
+			}
+			
+			std::size_t nstrikes = m_strikes.size(), nmaturities = m_maturities.size();
+			std::string buffer = "Name";
+			for(std::size_t i = 0; i < nmaturities; ++i)
+			{
+				for(std::size_t j = 0; j < nstrikes; ++j)
+				{
+					buffer += ';';
+					csv::append_double(buffer, m_maturities[i]);
+					buffer += "M_";
+					csv::append_double(buffer, m_strikes[j]);
+				}
+			}
+			buffer += '\n';
+			
+			// written by blocks of about 1MB
+			for(std::size_t k = 0; k < m_entries.size(); ++k)
+			{
+				buffer += m_entries[k].name;
+				for(double vol : get_surface(k))
+				{
+					buffer += ';';
+					if(vol == vol)
+						csv::append_double(buffer, vol);
+				}
+				buffer += '\n';
+				if(buffer.size() >= (std::size_t(1) << 20))
+				{
+					file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+					buffer.clear();
+				}
+			}
+			if(!buffer.empty())
+				file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+			PROJECT_LOG_INFO("universe: " << m_entries.size() << " surfaces exported to " << path);
+		}
+		
+	}
+	
+}
@@ -0,0 +1,135 @@
+#ifndef UNIVERSE_HPP
+#define UNIVERSE_HPP
+
+// libs of the project
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "thread_pool.hpp" // parallel computations
+#include "functions.hpp" // accuracy of the pnl computations
+
+namespace project
+{
+	
+	namespace VS
+	{
+		
+		/* ---------------------------------- */
+		/* ---- UNIVERSE OF UNDERLYINGS ---- */
+		/* ---------------------------------- */
+		
+		// views of the surfaces, see vol_surface.hpp
+		class vol_view;
+		
+		// one underlying of a universe: its name and its data file (csv or snapshot, see time_series)
+		struct universe_entry
+		{
+			std::string name;
+			std::string path;
+		};
+		
+		// vol surfaces of many underlyings on one thread pool:
+		// - each underlying is loaded by a task (one thread per file: the pool is never oversubscribed), which
+		//   then submits one task per cell (maturity, strike) on the same pool, longest maturities first
+		// - the schedule of a range is shared by the strikes of its maturity (see BS::hedge_schedule)
+		// - an underlying is released as soon as its last cell is computed, and the next ones are only loaded
+		//   while the estimated memory of the underlyings in flight stays within the memory budget
+		// the surfaces are written to one csv file: one line per underlying, one column per cell
+		class universe
+		{
+		public:
+			
+			// constructors
+			universe(std::vector<double> maturities = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},
+					 std::vector<double> strikes = {50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150});
+			
+			// destructor
+			~universe();
+			
+			
+			// access - data members
+			std::size_t get_size() const; // number of underlyings
+			const std::vector<universe_entry>& get_entries() const;
+			const std::vector<double>& get_strikes() const;
+			const std::vector<double>& get_maturities() const;
+			std::size_t get_memory_budget() const; // in bytes (0: no limit)
+			double get_rate() const;
+			BS::accuracy get_accuracy() const;
+			
+			// access - results of the last run: the surface of underlying k starts at k * maturities * strikes
+			// (same layout as vol_surface), NaN when the cell could not be computed
+			const std::vector<double>& get_vols() const;
+			vol_view get_surface(std::size_t k) const; // surface of underlying k, without copy
+			vol_view get_cell(double strike, double maturity) const; // one cell of all the underlyings (strided)
+			
+			
+			// modify - underlyings (return the number of underlyings added)
+			void add(const std::string& name, const std::string& path);
+			std::size_t add_directory(const std::string& dir); // every file of the directory, named after the file
+			std::size_t add_manifest(const std::string& path); // one "name;path" line per underlying (relative to the manifest)
+			void clear();
+			
+			// modify - parameters
+			void let_memory_budget(std::size_t bytes);
+			void let_rate(double rate);
+			void let_accuracy(BS::accuracy acc); // of the pnl computations (see hedged_ptf::let_accuracy), full by default
+			
+			
+			// computes the surfaces of all the underlyings and writes them to a csv file
+			// returns the number of underlyings loaded
+			std::size_t run(const std::string& path, bool robust_pnl = false, std::size_t nb_threads = 0); // 0: one thread per core
+			// on an existing pool, which must not be running the caller: run waits for all the tasks of the pool
+			// (pool.wait()), a call from one of its tasks would wait for itself
+			std::size_t run(MT::thread_pool& pool, const std::string& path, bool robust_pnl = false);
+			
+			// export of the last run: csv (as run) or binary, one surface per underlying loaded (see VS::surface_writer)
+			void export_to_csv(const std::string& path) const;
+			void export_to_binary(const std::string& path, bool append = false) const;
+		
+		
+		
+		
+		private:
+			
+			// data members
+			std::vector<universe_entry> m_entries;
+			std::vector<double> m_strikes; // in % of the spot at the start of the range
+			std::vector<double> m_maturities; // in months
+			std::size_t m_memory_budget;
+			double m_rate;
+			BS::accuracy m_accuracy;
+			bool m_robust_pnl; // method of the last run
+			std::vector<double> m_vols;
+			std::vector<std::int32_t> m_as_of; // last date of each underlying (TS::day_t)
+			std::vector<unsigned char> m_loaded; // whether each underlying was loaded (one byte each: set by the tasks)
+			
+			// memory of an underlying while it is in flight (series, cached columns and schedules), from its file size
+			std::size_t estimate_memory(const universe_entry& entry) const;
+			
+		};
+		
+	}
+	
+}
+
+
+
+#endif
@@ -0,0 +1,114 @@
+#include "universe.hpp"
+
+// Vol surfaces of a universe of underlyings, computed on one thread pool
+// usage: project_universe (--manifest FILE | --dir PATH) [--out FILE] [--bin FILE] [--threads N] [--memory MB]
+//                         [--pnl delta|robust] [--rate R] [--accuracy full|high|fast|single]
+// the manifest has one "name;path" line per underlying, a directory gives one underlying per file (named after the file)
+// the surfaces are written to --out (universe.csv by default): one line per underlying, one column per cell
+// and, with --bin, to a binary file of surfaces (see VS::surface_writer)
+// --accuracy single computes the normal distributions in float, for nightly runs where a few 1e-4 on the delta pnl
+// vols of the deep in / out of the money cells is enough (see BS::hedged_ptf::let_accuracy)
+
+namespace
+{
+	void print_usage()
+	{
+		std::cerr << "usage: project_universe (--manifest FILE | --dir PATH) [--out FILE] [--bin FILE] [--threads N] [--memory MB]"
+				  << " [--pnl delta|robust] [--rate R] [--accuracy full|high|fast|single]" << std::endl;
+	}
+	
+	// whole value only (std::stoul and std::stod stop at the first invalid character, std::stoul wraps negatives)
+	std::size_t to_size(const std::string& value)
+	{
+		std::size_t pos = 0;
+		std::size_t result = std::stoul(value, &pos);
+		if((pos != value.size()) || (value.find('-') != std::string::npos))
+			throw std::invalid_argument(value);
+		return result;
+	}
+	
+	double to_double(const std::string& value)
+	{
+		std::size_t pos = 0;
+		double result = std::stod(value, &pos);
+		if(pos != value.size())
+			throw std::invalid_argument(value);
+		return result;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string manifest, dir, out_path = "universe.csv", bin_path;
+	std::size_t nb_threads = 0, memory = 0;
+	bool robust_pnl = false;
+	double rate = 0.01;
+	project::BS::accuracy acc = project::BS::accuracy::full;
+
+	for(int i = 1; i < argc; i += 2)
+	{
+		std::string option(argv[i]);
+		if(i + 1 == argc)
+		{
+			std::cerr << "Missing value of option " << option << std::endl;
+			print_usage();
+			return 1;
+		}
+		std::string value(argv[i + 1]);
+		try
+		{
+			if(option == "--manifest")
+				manifest = value;
+			else if(option == "--dir")
+				dir = value;
+			else if(option == "--out")
+				out_path = value;
+			else if(option == "--bin")
+				bin_path = value;
+			else if(option == "--threads")
+				nb_threads = to_size(value);
+			else if(option == "--memory")
+				memory = to_size(value);
+			else if(option == "--pnl" && (value == "delta" || value == "robust"))
+				robust_pnl = (value == "robust");
+			else if(option == "--rate")
+				rate = to_double(value);
+			else if(option == "--accuracy" && (value == "full" || value == "high" || value == "fast" || value == "single"))
+				acc = (value == "full") ? project::BS::accuracy::full : (value == "high") ? project::BS::accuracy::high
+					: (value == "fast") ? project::BS::accuracy::fast : project::BS::accuracy::single;
+			else
+			{
+				std::cerr << "Unknown option " << option << " " << value << std::endl;
+				print_usage();
+				return 1;
+			}
+		}
+		catch(const std::exception&)
+		{
+			std::cerr << "Invalid value " << value << " of option " << option << std::endl;
+			print_usage();
+			return 1;
+		}
+	}
+	if(manifest.empty() == dir.empty())
+	{
+		print_usage();
+		return 1;
+	}
+
+	project::VS::universe u;
+	u.let_rate(rate);
+	u.let_accuracy(acc);
+	u.let_memory_budget(memory << 20);
+	if(!manifest.empty())
+		u.add_manifest(manifest);
+	else
+		u.add_directory(dir);
+	if(u.get_size() == 0)
+		return 1;
+
+	std::size_t loaded = u.run(out_path, robust_pnl, nb_threads);
+	if(!bin_path.empty())
+		u.export_to_binary(bin_path);
+	return (loaded == u.get_size()) ? 0 : 2;
+}
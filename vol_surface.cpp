@@ -2,6 +2,7 @@
 #include "hedged_ptf.hpp"
 #include "vol_surface.hpp"
 #include "functions.hpp"
+#include "surface_file.hpp"
 
 namespace project
 {
@@ -13,12 +14,241 @@ namespace project
 		/* ---- VOLATILITY SURFACE CLASS ---- */
 		/* ---------------------------------- */
 		
+		namespace
+		{
+			// strikes or maturities on one line (for the log messages)
+			std::string join(const std::vector<double>& values)
+			{
+				std::ostringstream line;
+				for(std::size_t i = 0; i < values.size(); ++i)
+					line << values[i] << ' ';
+				return line.str();
+			}
+			
+			// sorted and distinct nodes of a grid, with the position of each node in the grid
+			std::vector<double> sorted_nodes(const std::vector<double>& values, std::vector<std::size_t>& order)
+			{
+				order.resize(values.size());
+				std::iota(order.begin(), order.end(), 0);
+				std::stable_sort(order.begin(), order.end(), [&values](std::size_t a, std::size_t b)
+				{
+					return values[a] < values[b];
+				});
+				order.erase(std::unique(order.begin(), order.end(), [&values](std::size_t a, std::size_t b)
+				{
+					return values[a] == values[b];
+				}), order.end());
+				std::vector<double> nodes(order.size());
+				for(std::size_t i = 0; i < order.size(); ++i)
+					nodes[i] = values[order[i]];
+				return nodes;
+			}
+		}
+		
+		
+		
+		/* ------------------ */
+		/* ---- VOL VIEW ---- */
+		/* ------------------ */
+		
+		// constructors
+		vol_view::vol_view()
+			: p_data(nullptr), m_size(0), m_stride(1)
+		{
+		}
+		
+		vol_view::vol_view(const double* data, std::size_t size, std::size_t stride)
+			: p_data(data), m_size(size), m_stride(stride)
+		{
+		}
+		
+		
+		
+		// access
+		std::size_t vol_view::size() const
+		{
+			return m_size;
+		}
+		
+		bool vol_view::empty() const
+		{
+			return m_size == 0;
+		}
+		
+		const double* vol_view::data() const
+		{
+			return p_data;
+		}
+		
+		std::size_t vol_view::stride() const
+		{
+			return m_stride;
+		}
+		
+		vol_view::iterator vol_view::begin() const
+		{
+			return iterator(p_data, m_stride, 0);
+		}
+		
+		vol_view::iterator vol_view::end() const
+		{
+			return iterator(p_data, m_stride, m_size);
+		}
+		
+		double vol_view::operator[](std::size_t i) const
+		{
+			return p_data[i * m_stride];
+		}
+		
+		std::vector<double> vol_view::to_vector() const
+		{
+			if(m_stride == 1)
+				return std::vector<double>(p_data, p_data + m_size);
+			std::vector<double> values(m_size);
+			for(std::size_t i = 0; i < m_size; ++i)
+				values[i] = p_data[i * m_stride];
+			return values;
+		}
+		
+		
+		// iterator (the index is kept rather than a pointer, which would go past the end of the strided data)
+		vol_view::iterator::iterator()
+			: p_data(nullptr), m_stride(1), m_index(0)
+		{
+		}
+		
+		vol_view::iterator::iterator(const double* data, std::size_t stride, std::size_t i)
+			: p_data(data), m_stride(stride), m_index(i)
+		{
+		}
+		
+		vol_view::iterator::reference vol_view::iterator::operator*() const
+		{
+			return p_data[m_index * m_stride];
+		}
+		
+		vol_view::iterator::pointer vol_view::iterator::operator->() const
+		{
+			return p_data + m_index * m_stride;
+		}
+		
+		vol_view::iterator& vol_view::iterator::operator++()
+		{
+			++m_index;
+			return *this;
+		}
+		
+		vol_view::iterator vol_view::iterator::operator++(int)
+		{
+			iterator previous = *this;
+			++m_index;
+			return previous;
+		}
+		
+		bool vol_view::iterator::operator==(const iterator& other) const
+		{
+			return m_index == other.m_index;
+		}
+		
+		bool vol_view::iterator::operator!=(const iterator& other) const
+		{
+			return m_index != other.m_index;
+		}
+		
+		
+		
+		/* ---------------------- */
+		/* ---- GRID LOCATOR ---- */
+		/* ---------------------- */
+		
+		// constructors
+		grid_locator::grid_locator()
+			: m_origin(0.0), m_scale(0.0), m_affine(false)
+		{
+		}
+		
+		grid_locator::grid_locator(const std::vector<double>& nodes)
+			: m_nodes(nodes), m_origin(nodes.empty() ? 0.0 : nodes.front()), m_scale(0.0), m_affine(false)
+		{
+			std::size_t n = m_nodes.size();
+			if(n < 2)
+				return;
+			
+			// equally spaced nodes (eg. the default grids): the interval is computed, no table
+			double width = m_nodes[n-1] - m_nodes[0], spacing = width;
+			double step = width / static_cast<double>(n - 1);
+			m_affine = true;
+			for(std::size_t i = 1; i < n; ++i)
+			{
+				spacing = std::min(spacing, m_nodes[i] - m_nodes[i-1]);
+				m_affine &= std::abs(m_nodes[i] - (m_origin + static_cast<double>(i) * step)) <= 1e-12 * width;
+			}
+			if(m_affine)
+			{
+				m_scale = 1.0 / step;
+				return;
+			}
+			
+			// buckets not wider than the smallest spacing: at most one node inside each bucket
+			double nb_buckets = std::min(std::ceil(width / spacing), 4096.0);
+			std::size_t nb = std::max(static_cast<std::size_t>(nb_buckets), n);
+			m_scale = static_cast<double>(nb) / width;
+			
+			// first interval of each bucket: the last node at or before the start of the bucket
+			m_buckets.resize(nb);
+			std::size_t i = 0;
+			for(std::size_t b = 0; b < nb; ++b)
+			{
+				double x = m_origin + static_cast<double>(b) / m_scale;
+				while(i + 2 < n && m_nodes[i+1] <= x)
+					++i;
+				m_buckets[b] = static_cast<std::uint32_t>(i);
+			}
+		}
+		
+		
+		
+		// access
+		std::size_t grid_locator::get_size() const
+		{
+			return m_nodes.size();
+		}
+		
+		const std::vector<double>& grid_locator::get_nodes() const
+		{
+			return m_nodes;
+		}
+		
+		std::size_t grid_locator::locate(double x) const
+		{
+			// clamped bucket (NaN goes to the first one)
+			double pos = (x - m_origin) * m_scale;
+			if(m_affine)
+			{
+				double last = static_cast<double>(m_nodes.size() - 2);
+				return (pos > 0.0) ? static_cast<std::size_t>(std::min(pos, last)) : 0;
+			}
+			if(m_buckets.empty())
+				return 0;
+			double last = static_cast<double>(m_buckets.size() - 1);
+			std::size_t b = (pos > 0.0) ? static_cast<std::size_t>(std::min(pos, last)) : 0;
+			std::size_t i = m_buckets[b];
+			while(i + 2 < m_nodes.size() && m_nodes[i+1] <= x)
+				++i;
+			return i;
+		}
+		
+		
+		
 		// constructors
 		vol_surface::vol_surface(BS::hedged_ptf& ptf, std::vector<double> maturities, std::vector<double> strikes)
 			: p_ptf(&ptf), m_strikes(strikes), m_maturities(maturities)
 		{
 			m_robust_pnl = false; // by default, we want the delta P&L
 			m_vols.resize(strikes.size() * maturities.size());
+			m_vols_by_strike.resize(strikes.size() * maturities.size());
+			reset_ranges();
+			update_grids();
 		}
 		
 		
@@ -26,7 +256,7 @@ namespace project
 		// destructor
 		vol_surface::~vol_surface()
 		{
-			std::cout << "Deletion of vol_suraface object " << get_name() << std::endl;
+			PROJECT_LOG_DEBUG("Deletion of vol_suraface object " << get_name());
 			// Care: No pointer destroyer!!! It would create a seg fault as the hedged_ptf is independent
 		}
 		
@@ -64,50 +294,159 @@ namespace project
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
+				PROJECT_LOG_ERROR(msg);
 				return 0;
 			}
 			return vol;
 		}
 		
+		// interpolated vol of any point (see VS::interpolation)
+		double vol_surface::get_vol(double strike, double maturity, interpolation method) const
+		{
+			double vol;
+			get_vols(&strike, &maturity, 1, &vol, method);
+			return vol;
+		}
+		
+		// interpolated vols of n points
+		void vol_surface::get_vols(const double* strikes, const double* maturities, std::size_t n, double* vols,
+								   interpolation method) const
+		{
+			const double* k_nodes = m_strike_grid.get_nodes().data();
+			const double* t_nodes = m_maturity_grid.get_nodes().data();
+			std::size_t nk = m_strike_grid.get_size(), nt = m_maturity_grid.get_size();
+			if((nk == 0) | (nt == 0))
+			{
+				std::fill(vols, vols + n, 0.0);
+				return;
+			}
+			
+			// points by blocks: 1. location of the cells, 2. interpolation (branch-free, vectorizable)
+			const std::size_t block = 64;
+			std::size_t ks[block], ts[block];
+			double dk[block], wt[block];
+			const double* grid_vols = m_grid_vols.data();
+			const double* slopes = m_slopes.data();
+			const double* cubic = m_cubic.data();
+			std::size_t row = (nk > 1) ? nk - 1 : 1; // intervals per maturity
+			for(std::size_t first = 0; first < n; first += block)
+			{
+				std::size_t size = std::min(block, n - first);
+				const double* strike = strikes + first;
+				const double* maturity = maturities + first;
+				double* vol = vols + first;
+				
+				// strike interval and offset in it (clamped: flat extrapolation)
+				for(std::size_t p = 0; p < size; ++p)
+				{
+					std::size_t j = m_strike_grid.locate(strike[p]);
+					double width = (nk > 1) ? k_nodes[j+1] - k_nodes[j] : 0.0;
+					ks[p] = j;
+					dk[p] = std::min(std::max(strike[p] - k_nodes[j], 0.0), width);
+				}
+				// maturity interval and weight of its second node
+				for(std::size_t p = 0; p < size; ++p)
+				{
+					std::size_t i = m_maturity_grid.locate(maturity[p]);
+					double weight = (nt > 1) ? (maturity[p] - t_nodes[i]) / (t_nodes[i+1] - t_nodes[i]) : 0.0;
+					ts[p] = i;
+					wt[p] = std::min(std::max(weight, 0.0), 1.0);
+				}
+				
+				std::size_t next = (nt > 1) ? 1 : 0; // second maturity of the interval
+				if(method == interpolation::bilinear)
+				{
+					for(std::size_t p = 0; p < size; ++p)
+					{
+						std::size_t c0 = ts[p] * nk + ks[p], c1 = (ts[p] + next) * nk + ks[p];
+						std::size_t s0 = ts[p] * row + ks[p], s1 = (ts[p] + next) * row + ks[p];
+						double v0 = grid_vols[c0] + slopes[s0] * dk[p];
+						double v1 = grid_vols[c1] + slopes[s1] * dk[p];
+						vol[p] = v0 + wt[p] * (v1 - v0);
+					}
+				}
+				else
+				{
+					for(std::size_t p = 0; p < size; ++p)
+					{
+						const double* c0 = cubic + 4 * (ts[p] * row + ks[p]);
+						const double* c1 = cubic + 4 * ((ts[p] + next) * row + ks[p]);
+						double x = dk[p];
+						double v0 = c0[0] + x * (c0[1] + x * (c0[2] + x * c0[3]));
+						double v1 = c1[0] + x * (c1[1] + x * (c1[2] + x * c1[3]));
+						// total variance linear in maturity, between the two nodes
+						double t0 = t_nodes[ts[p]], t1 = t_nodes[ts[p] + next];
+						double t = t0 + wt[p] * (t1 - t0);
+						double variance = v0 * v0 * t0 + wt[p] * (v1 * v1 * t1 - v0 * v0 * t0);
+						vol[p] = (t > 0.0) ? std::sqrt(std::max(variance, 0.0) / t) : v0;
+					}
+				}
+			}
+		}
+		
 		// term structure (for a given strike)
 		std::vector<double> vol_surface::get_strike(double strike) const 
 		{
-			std::vector<double> term_structure(m_maturities.size()); // has to be declared outside
+			vol_view term_structure = get_term_structure(strike);
+			return term_structure.empty() ? std::vector<double> {0} : term_structure.to_vector();
+		}
+		
+		// skew (for a given maturity)
+		std::vector<double> vol_surface::get_maturity(double maturity) const 
+		{
+			vol_view skew = get_skew(maturity);
+			return skew.empty() ? std::vector<double> {0} : skew.to_vector();
+		}
+		
+		// term structure without copy: contiguous in the surface stored by strike
+		vol_view vol_surface::get_term_structure(double strike) const
+		{
 			try
 			{
-				// fill the term_structure vector looping through maturities
-				for(std::size_t i = 0; i < m_maturities.size(); ++i)
-				{
-					term_structure[i] = m_vols[i * m_strikes.size() + index_strike(strike)];
-				}
+				return vol_view(m_vols_by_strike.data() + index_strike(strike) * m_maturities.size(), m_maturities.size());
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
-				return std::vector<double> {0};
+				PROJECT_LOG_ERROR(msg);
+				return vol_view();
 			}
-			return term_structure;
 		}
 		
-		// skew (for a given maturity)
-		std::vector<double> vol_surface::get_maturity(double maturity) const 
+		// skew without copy: contiguous in the surface stored by maturity
+		vol_view vol_surface::get_skew(double maturity) const
 		{
-			std::vector<double> skew(m_strikes.size()); // has to be declared outside
 			try
 			{
-				// fill the skew vector looping through strikes
-				for(std::size_t i = 0; i < m_strikes.size(); ++i)
-				{
-					skew[i] = m_vols[index_maturity(maturity) * m_strikes.size() + i];
-				}
+				return vol_view(m_vols.data() + index_maturity(maturity) * m_strikes.size(), m_strikes.size());
 			}
 			catch(const char* msg)
 			{
-				std::cerr << msg << std::endl;
-				return std::vector<double> {0};
+				PROJECT_LOG_ERROR(msg);
+				return vol_view();
 			}
-			return skew;
+		}
+		
+		
+		
+		// access - diagnostics
+		const std::vector<cell_diagnostics>& vol_surface::get_diagnostics() const
+		{
+			return m_diagnostics;
+		}
+		
+		// diagnostics of one cell
+		cell_diagnostics vol_surface::get_diagnostics(double strike, double maturity) const
+		{
+			cell_diagnostics diagnostics = cell_diagnostics();
+			try
+			{
+				diagnostics = m_diagnostics[index_maturity(maturity) * m_strikes.size() + index_strike(strike)];
+			}
+			catch(const char* msg)
+			{
+				PROJECT_LOG_ERROR(msg);
+			}
+			return diagnostics;
 		}
 		
 		
@@ -145,7 +484,7 @@ namespace project
 		// term structure (for a given strike)
 		void vol_surface::print_strike(double strike) const 
 		{
-			std::vector<double> term_structure = get_strike(strike);
+			vol_view term_structure = get_term_structure(strike);
 			std::cout << "Term structure for strike " << strike << std::endl;
 			for(std::size_t i = 0; i < term_structure.size(); ++i)
 			{
@@ -163,7 +502,7 @@ namespace project
 		// skew (for a given maturity)
 		void vol_surface::print_maturity(double maturity) const 
 		{
-			std::vector<double> skew = get_maturity(maturity);
+			vol_view skew = get_skew(maturity);
 			std::cout << "Skew for maturity " << maturity << std::endl;
 			for(std::size_t i = 0; i < skew.size(); ++i)
 			{
@@ -218,59 +557,187 @@ namespace project
 		// modify
 		
 		// load the volatility surface using ptf.get_implied_vol() method.
-		void vol_surface::load_vol_surface(bool robust_pnl)
+		void vol_surface::load_vol_surface(bool robust_pnl, std::size_t nb_threads)
+		{
+			MT::thread_pool pool(nb_threads);
+			load_vol_surface(pool, robust_pnl);
+		}
+		
+		void vol_surface::load_vol_surface(MT::thread_pool& pool, bool robust_pnl)
 		{
 			m_robust_pnl = robust_pnl;
+			const TS::time_series& ts = p_ptf->get_ts();
+			std::size_t end = ts.get_size();
+			
+			// the cost of a cell is proportional to the size of its range:
+			// maturities are submitted from the longest to the shortest so that the pool is balanced
 			// outside loop on maturities
-			for(std::size_t i = 0; i < m_maturities.size(); ++i)
+			for(std::size_t i : maturities_order())
 			{
-				// set maturity (important to do it before setting the strike as it is in %)
-				p_ptf->let_last_range(static_cast<int>(m_maturities[i]));
+				// range of the last months (the strike is in % of the spot at the start of the range)
+				std::size_t start = p_ptf->get_last_start(static_cast<std::size_t>(m_maturities[i]));
+				if(skip_range(i, start, end))
+					continue;
+				double spot = ts[start];
+				store_range(i, start, end);
+				// the schedule of the range is shared by the strikes of the maturity
+				std::shared_ptr<const BS::hedge_schedule> schedule = std::make_shared<const BS::hedge_schedule>(*p_ptf, start, end);
 				// inside loop on strikes
 				for(std::size_t j = 0; j < m_strikes.size(); ++j)
 				{
-					// set strike
-					p_ptf->let_strike(m_strikes[j]);
-					// compute breakeven volatility
-					m_vols[i * m_strikes.size() + j] = p_ptf->get_implied_vol(m_robust_pnl); 
+					// each task writes its own cell
+					double strike = m_strikes[j] * spot / 100.0;
+					std::size_t cell = i * m_strikes.size() + j;
+					pool.submit([this, schedule, start, end, strike, robust_pnl, cell]()
+					{
+						// compute breakeven volatility (same solver as ptf.get_implied_vol())
+						auto begin = std::chrono::steady_clock::now();
+						BS::solver_result result = p_ptf->solve_implied_vol(*schedule, strike, robust_pnl);
+						std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+						store_cell(cell, result, start, end, elapsed.count());
+					});
 				}
 			}
+			pool.wait();
+			update_interpolation();
+			
 			// depending on the method for PnL computation
 			std::string method = m_robust_pnl ? " (using Black-Scholes Robustness formula)" : "";
-			std::cout << "vol_surface " << get_name() << " correctly updated" << method << std::endl;
+			PROJECT_LOG_INFO("vol_surface " << get_name() << " correctly updated" << method);
+		}
+		
+		
+		void vol_surface::load_vol_surface_fused(bool robust_pnl, std::size_t nb_threads)
+		{
+			MT::thread_pool pool(nb_threads);
+			load_vol_surface_fused(pool, robust_pnl);
+		}
+		
+		void vol_surface::load_vol_surface_fused(MT::thread_pool& pool, bool robust_pnl)
+		{
+			m_robust_pnl = robust_pnl;
+			const TS::time_series& ts = p_ptf->get_ts();
+			std::size_t end = ts.get_size();
+			
+			// one task per maturity, writing its whole row (longest maturities first, as in load_vol_surface)
+			for(std::size_t i : maturities_order())
+			{
+				std::size_t start = p_ptf->get_last_start(static_cast<std::size_t>(m_maturities[i]));
+				if(skip_range(i, start, end))
+					continue;
+				double spot = ts[start];
+				store_range(i, start, end);
+				std::vector<double> strikes(m_strikes.size());
+				for(std::size_t j = 0; j < m_strikes.size(); ++j)
+					strikes[j] = m_strikes[j] * spot / 100.0;
+				std::size_t row = i * m_strikes.size();
+				pool.submit([this, start, end, strikes, robust_pnl, row]()
+				{
+					auto begin = std::chrono::steady_clock::now();
+					std::vector<BS::solver_result> results(strikes.size());
+					BS::hedge_schedule schedule(*p_ptf, start, end);
+					p_ptf->solve_implied_vols(schedule, strikes.data(), strikes.size(), results.data(), robust_pnl);
+					std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+					
+					// the time of the row is shared between its cells
+					for(std::size_t j = 0; j < strikes.size(); ++j)
+						store_cell(row + j, results[j], start, end, elapsed.count() / static_cast<double>(strikes.size()));
+				});
+			}
+			pool.wait();
+			update_interpolation();
+			
+			std::string method = m_robust_pnl ? " (using Black-Scholes Robustness formula)" : "";
+			PROJECT_LOG_INFO("vol_surface " << get_name() << " correctly updated" << method);
+		}
+		
+		
+		void vol_surface::refresh_vol_surface(std::size_t nb_threads)
+		{
+			MT::thread_pool pool(nb_threads);
+			refresh_vol_surface(pool);
+		}
+		
+		void vol_surface::refresh_vol_surface(MT::thread_pool& pool)
+		{
+			const TS::time_series& ts = p_ptf->get_ts();
+			std::size_t end = ts.get_size();
+			bool robust_pnl = m_robust_pnl; // same method as the last computation
+			std::size_t refreshed = 0;
+			
+			for(std::size_t i : maturities_order())
+			{
+				// unchanged range and parameters: the cells are still valid (an empty range is left uncomputed)
+				std::size_t start = p_ptf->get_last_start(static_cast<std::size_t>(m_maturities[i]));
+				if(skip_range(i, start, end) || is_current(i, start, end))
+					continue;
+				
+				// the previous vols are used as guesses (cold start if the maturity was never computed)
+				bool warm = (m_ends[i] != 0);
+				double spot = ts[start];
+				std::shared_ptr<const BS::hedge_schedule> schedule = std::make_shared<const BS::hedge_schedule>(*p_ptf, start, end);
+				for(std::size_t j = 0; j < m_strikes.size(); ++j)
+				{
+					double strike = m_strikes[j] * spot / 100.0;
+					std::size_t cell = i * m_strikes.size() + j;
+					pool.submit([this, schedule, start, end, strike, robust_pnl, cell, warm]()
+					{
+						auto begin = std::chrono::steady_clock::now();
+						double guess = m_vols[cell];
+						BS::solver_result result = (warm && guess > 0.0)
+							? p_ptf->solve_implied_vol_from(*schedule, strike, guess, robust_pnl)
+							: p_ptf->solve_implied_vol(*schedule, strike, robust_pnl);
+						std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+						store_cell(cell, result, start, end, elapsed.count());
+					});
+				}
+				store_range(i, start, end);
+				++refreshed;
+			}
+			pool.wait();
+			update_interpolation();
+			
+			PROJECT_LOG_INFO("vol_surface " << get_name() << " refreshed (" << refreshed << " of "
+					<< m_maturities.size() << " maturities)");
 		}
 		
 		
 		void vol_surface::let_strikes(std::vector<double> strikes)
 		{
 			m_strikes = strikes;
-			print_strikes();
-			std::cout << "New strikes correctly set: " << std::endl;
+			PROJECT_LOG_DEBUG("New strikes correctly set: " << join(m_strikes));
 			// erase the old implied volatilities and resize the vector
 			m_vols.clear();
 			m_vols.resize(m_strikes.size() * m_maturities.size());
+			m_vols_by_strike.assign(m_strikes.size() * m_maturities.size(), 0.0);
+			reset_ranges();
+			update_grids();
 		}
 		
 		void vol_surface::let_maturities(std::vector<double> maturities)
 		{
 			m_maturities = maturities;
-			std::cout << "New maturities correctly set: " << std::endl;
-			print_maturities();
+			PROJECT_LOG_DEBUG("New maturities correctly set: " << join(m_maturities));
 			// erase the old implied volatilities and resize the vector
 			m_vols.clear();
 			m_vols.resize(m_strikes.size() * m_maturities.size());
+			m_vols_by_strike.assign(m_strikes.size() * m_maturities.size(), 0.0);
+			reset_ranges();
+			update_grids();
 		}
 		
 		// changing the reference portfolio
 		void vol_surface::let_ptf(BS::hedged_ptf& ptf)
 		{
-			std::cout << "On vol_suraface object, target hedged_ptf object changed from " << get_name() << " to " << ptf.get_name() << std::endl;
+			PROJECT_LOG_DEBUG("On vol_suraface object, target hedged_ptf object changed from " << get_name() << " to " << ptf.get_name());
 			p_ptf = &ptf;
+			reset_ranges();
 		}
 		
 		
 		
 		// export the volatility surface in .csv format
+		// the file is formatted in one buffer (see csv::format_double) and written at once
 		void vol_surface::export_to_csv(std::string path) const
 		{
 			// name of the file depends on the method used for PnL computation
@@ -278,61 +745,254 @@ namespace project
 			
 			// set the path and the name of our file
 			std::ofstream file(path + get_name() + method + std::string("_vol.csv"));
-			std::size_t mat = 0;
+			std::string buffer;
+			buffer.reserve((m_vols.size() + m_strikes.size() + m_maturities.size() + 1) * 16);
 			
 			// export first line (strikes)
-			file << "Maturities\\Strikes;";
+			buffer += "Maturities\\Strikes;";
 			for(std::size_t i = 0; i < m_strikes.size(); ++i)
 			{
-				file << m_strikes[i] << ';';
+				csv::append_double(buffer, m_strikes[i]);
+				buffer += ';';
 			}
 			
-			// export rest of the file
-			for(std::size_t i = 0; i < m_vols.size(); ++i)
+			// export rest of the file: one line per maturity (its skew)
+			for(std::size_t i = 0; i < m_maturities.size(); ++i)
 			{
-				if(i%m_strikes.size() == 0)
+				buffer += '\n';
+				csv::append_double(buffer, m_maturities[i]);
+				buffer += ';';
+				for(double vol : vol_view(m_vols.data() + i * m_strikes.size(), m_strikes.size()))
 				{
-					file << '\n' << m_maturities[mat++] << ';';
+					csv::append_double(buffer, vol);
+					buffer += ';';
 				}
-				file << m_vols[i] << ';';
 			}
+			file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 			// final message
-			std::cout << "vol_surface " << get_name() << " exported to " << get_name() << method << "_vol.csv" << std::endl;
+			PROJECT_LOG_INFO("vol_surface " << get_name() << " exported to " << get_name() << method << "_vol.csv");
 			file.close();
 		}
 		
+		// export the volatility surface in binary format (see VS::surface_writer)
+		void vol_surface::export_to_binary(std::string path) const
+		{
+			std::string method = m_robust_pnl ? "_robust" : "";
+			try
+			{
+				surface_writer writer(path + get_name() + method + std::string("_vol.bin"));
+				export_to_binary(writer);
+			}
+			catch(const char* msg)
+			{
+				PROJECT_LOG_ERROR(msg);
+			}
+		}
 		
+		// appends the volatility surface to a binary file, with the last date of the data
+		void vol_surface::export_to_binary(surface_writer& writer) const
+		{
+			const TS::time_series& ts = p_ptf->get_ts();
+			TS::day_t as_of = (ts.get_size() > 0) ? ts.get_day(ts.get_size()) : 0;
+			writer.write(get_name(), m_strikes, m_maturities, m_vols.data(), m_robust_pnl, as_of);
+		}
+		
+		// export the diagnostics of the cells in .csv format (next to the volatility surface)
+		void vol_surface::export_diagnostics_to_csv(std::string path) const
+		{
+			std::string method = m_robust_pnl ? "_robust" : "";
+			std::ofstream file(path + get_name() + method + std::string("_diagnostics.csv"));
+			
+			// one line per cell (same order as the vols: maturities then strikes)
+			file << "Maturity;Strike;Vol;Converged;Residual;PnL evaluations;Sweeps;Days;Seconds";
+			for(std::size_t i = 0; i < m_vols.size(); ++i)
+			{
+				const cell_diagnostics& diagnostics = m_diagnostics[i];
+				file << '\n' << m_maturities[i / m_strikes.size()] << ';' << m_strikes[i % m_strikes.size()] << ';';
+				if(!diagnostics.computed)
+				{
+					file << ";;;;;;"; // empty cells
+					continue;
+				}
+				file << m_vols[i] << ';' << diagnostics.converged << ';' << diagnostics.residual << ';'
+					<< diagnostics.pnl_evaluations << ';' << diagnostics.sweeps << ';' << diagnostics.days << ';'
+					<< diagnostics.seconds;
+			}
+			PROJECT_LOG_INFO("vol_surface " << get_name() << " diagnostics exported to " << get_name() << method << "_diagnostics.csv");
+			file.close();
+		}
 		
 		
 		
 		
 		
 		
-		// private methods for getting indices
+		
+		
+		// private methods for getting indices (located in the sorted grids)
 		std::size_t vol_surface::index_strike(double strike) const
 		{
-			auto pos = std::find(m_strikes.cbegin(), m_strikes.cend(), strike);
-			if(pos == m_strikes.cend())
+			const std::vector<double>& nodes = m_strike_grid.get_nodes();
+			std::size_t i = m_strike_grid.locate(strike);
+			for(std::size_t k = i; k < std::min(i + 2, nodes.size()); ++k)
 			{
-				throw "Strike not found!";
+				if(nodes[k] == strike)
+					return m_strike_order[k];
 			}
-			else
+			throw "Strike not found!";
+		}
+		
+		std::size_t vol_surface::index_maturity(double maturity) const
+		{
+			const std::vector<double>& nodes = m_maturity_grid.get_nodes();
+			std::size_t i = m_maturity_grid.locate(maturity);
+			for(std::size_t k = i; k < std::min(i + 2, nodes.size()); ++k)
 			{
-				return std::distance(m_strikes.cbegin(), pos);
+				if(nodes[k] == maturity)
+					return m_maturity_order[k];
 			}
+			throw "Maturity not found!";
 		}
 		
-		std::size_t vol_surface::index_maturity(double maturity) const
+		// sorted grids of the strikes and the maturities
+		void vol_surface::update_grids()
+		{
+			m_strike_grid = grid_locator(sorted_nodes(m_strikes, m_strike_order));
+			m_maturity_grid = grid_locator(sorted_nodes(m_maturities, m_maturity_order));
+			update_interpolation();
+		}
+		
+		// interpolation coefficients of the current vols
+		void vol_surface::update_interpolation()
 		{
-			auto pos = std::find(m_maturities.cbegin(), m_maturities.cend(), maturity);
-			if(pos == m_maturities.cend())
+			const std::vector<double>& k_nodes = m_strike_grid.get_nodes();
+			std::size_t nk = k_nodes.size(), nt = m_maturity_grid.get_size();
+			std::size_t row = (nk > 1) ? nk - 1 : 1;
+			m_grid_vols.assign(nk * nt, 0.0);
+			m_slopes.assign(row * nt, 0.0);
+			m_cubic.assign(4 * row * nt, 0.0);
+			
+			std::vector<double> deltas(row, 0.0), tangents(nk, 0.0);
+			for(std::size_t i = 0; i < nt; ++i)
 			{
-				throw "Maturity not found!";
+				// vols of the maturity in the order of the sorted strikes
+				double* v = m_grid_vols.data() + i * nk;
+				for(std::size_t j = 0; j < nk; ++j)
+					v[j] = m_vols[m_maturity_order[i] * m_strikes.size() + m_strike_order[j]];
+				
+				double* slopes = m_slopes.data() + i * row;
+				double* cubic = m_cubic.data() + 4 * i * row;
+				if(nk == 1)
+				{
+					cubic[0] = v[0];
+					continue;
+				}
+				
+				// slopes of the intervals, then monotone tangents at the nodes (Fritsch-Butland):
+				// weighted harmonic mean of the neighbouring slopes, 0 at a local extremum
+				for(std::size_t j = 0; j + 1 < nk; ++j)
+				{
+					deltas[j] = (v[j+1] - v[j]) / (k_nodes[j+1] - k_nodes[j]);
+					slopes[j] = deltas[j];
+				}
+				tangents[0] = deltas[0];
+				tangents[nk-1] = deltas[nk-2];
+				for(std::size_t j = 1; j + 1 < nk; ++j)
+				{
+					double h0 = k_nodes[j] - k_nodes[j-1], h1 = k_nodes[j+1] - k_nodes[j];
+					double d0 = deltas[j-1], d1 = deltas[j];
+					tangents[j] = (d0 * d1 > 0.0) ? 3.0 * (h0 + h1) / ((2.0 * h1 + h0) / d0 + (h1 + 2.0 * h0) / d1) : 0.0;
+				}
+				
+				// Hermite cubic of each interval: a + b x + c x^2 + d x^3 with x = strike - node
+				for(std::size_t j = 0; j + 1 < nk; ++j)
+				{
+					double h = k_nodes[j+1] - k_nodes[j];
+					cubic[4*j] = v[j];
+					cubic[4*j+1] = tangents[j];
+					cubic[4*j+2] = (3.0 * deltas[j] - 2.0 * tangents[j] - tangents[j+1]) / h;
+					cubic[4*j+3] = (tangents[j] + tangents[j+1] - 2.0 * deltas[j]) / (h * h);
+				}
+			}
+		}
+		
+		// maturities from the longest to the shortest
+		std::vector<std::size_t> vol_surface::maturities_order() const
+		{
+			std::vector<std::size_t> order(m_maturities.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b)
+			{
+				return m_maturities[a] > m_maturities[b];
+			});
+			return order;
+		}
+		
+		// forgets the ranges (and the diagnostics) of the last computation
+		void vol_surface::reset_ranges()
+		{
+			m_starts.assign(m_maturities.size(), 0);
+			m_ends.assign(m_maturities.size(), 0);
+			m_rates.assign(m_maturities.size(), 0.0);
+			m_day_counts.assign(m_maturities.size(), TS::day_count::act_365);
+			m_accuracies.assign(m_maturities.size(), BS::accuracy::full);
+			m_diagnostics.assign(m_strikes.size() * m_maturities.size(), cell_diagnostics());
+		}
+		
+		// range of a maturity, with the parameters of the ptf that change its vols
+		void vol_surface::store_range(std::size_t maturity, std::size_t start, std::size_t end)
+		{
+			m_starts[maturity] = start;
+			m_ends[maturity] = end;
+			m_rates[maturity] = p_ptf->get_rate();
+			m_day_counts[maturity] = p_ptf->get_day_count();
+			m_accuracies[maturity] = p_ptf->get_accuracy();
+		}
+		
+		bool vol_surface::is_current(std::size_t maturity, std::size_t start, std::size_t end) const
+		{
+			return (start == m_starts[maturity]) && (end == m_ends[maturity]) && (m_rates[maturity] == p_ptf->get_rate())
+				&& (m_day_counts[maturity] == p_ptf->get_day_count()) && (m_accuracies[maturity] == p_ptf->get_accuracy());
+		}
+		
+		bool vol_surface::skip_range(std::size_t maturity, std::size_t start, std::size_t end)
+		{
+			if(start < end)
+				return false;
+			PROJECT_LOG_WARNING("Empty range for maturity " << m_maturities[maturity] << " of vol_surface " << get_name()
+					<< ": maturity not computed");
+			store_range(maturity, start, 0);
+			for(std::size_t j = 0; j < m_strikes.size(); ++j)
+			{
+				std::size_t cell = maturity * m_strikes.size() + j;
+				m_vols[cell] = 0;
+				m_vols_by_strike[j * m_maturities.size() + maturity] = 0;
+				m_diagnostics[cell].computed = false;
 			}
-			else
+			return true;
+		}
+		
+		// writes the vol and the diagnostics of a cell
+		void vol_surface::store_cell(std::size_t index, BS::solver_result result, std::size_t start, std::size_t end, double seconds)
+		{
+			if(!result.converged)
 			{
-				return std::distance(m_maturities.cbegin(), pos);
+				PROJECT_LOG_WARNING("Solver for implied vol did not converge in " << result.iterations << " iterations");
+				result.vol = 0;
 			}
+			m_vols[index] = result.vol;
+			m_vols_by_strike[(index % m_strikes.size()) * m_maturities.size() + index / m_strikes.size()] = result.vol;
+			
+			cell_diagnostics& diagnostics = m_diagnostics[index];
+			diagnostics.start = start;
+			diagnostics.end = end;
+			diagnostics.pnl_evaluations = result.iterations;
+			diagnostics.sweeps = result.sweeps;
+			diagnostics.days = result.sweeps * (end - start + 1);
+			diagnostics.seconds = seconds;
+			diagnostics.residual = result.residual;
+			diagnostics.converged = result.converged;
+			diagnostics.computed = true;
 		}
 		
 		
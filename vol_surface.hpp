@@ -4,18 +4,23 @@
 // libs of the project
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "thread_pool.hpp" // parallel loading
+
 namespace project
 {
 	
@@ -26,6 +31,118 @@ namespace project
 		/* ---- VOLATILITY SURFACE CLASS ---- */
 		/* ---------------------------------- */
 		
+		// binary file of surfaces, see surface_file.hpp
+		class surface_writer;
+		
+		// diagnostics of one cell at its last computation
+		struct cell_diagnostics
+		{
+			std::size_t start; // range of the cell
+			std::size_t end;
+			std::size_t pnl_evaluations; // solver_result::iterations
+			std::size_t sweeps; // passes over the range (shared with the other strikes for the fused load)
+			std::size_t days; // days processed by these passes
+			double seconds; // time spent on the cell (a share of its row for the fused load)
+			double residual; // standardized pnl minus tolerance at the vol
+			bool converged;
+			bool computed; // false until the cell is computed
+		};
+		
+		// interpolation between the cells of a surface (flat extrapolation outside the grid)
+		enum class interpolation
+		{
+			bilinear, // vol linear in strike and in maturity
+			cubic // monotone cubic in strike (Fritsch-Butland slopes), total variance linear in maturity
+		};
+		
+		// location of a point in a sorted grid in O(1): the interval is computed for equally spaced nodes,
+		// otherwise a table of buckets, not wider than the smallest spacing of the grid (up to 4096 buckets),
+		// gives the interval of the point in one or two comparisons
+		class grid_locator
+		{
+		public:
+			
+			// constructors
+			grid_locator();
+			explicit grid_locator(const std::vector<double>& nodes); // sorted and distinct
+			
+			// access
+			std::size_t get_size() const;
+			const std::vector<double>& get_nodes() const;
+			
+			// index i of the interval [nodes[i], nodes[i+1]] containing x, clamped to the first and last
+			// intervals outside the grid (0 if the grid has less than 2 nodes)
+			std::size_t locate(double x) const;
+			
+			
+		private:
+			
+			// data members
+			std::vector<double> m_nodes;
+			std::vector<std::uint32_t> m_buckets; // first interval of each bucket
+			double m_origin;
+			double m_scale; // buckets per unit
+			bool m_affine; // equally spaced nodes: one bucket per interval, no table
+		};
+		
+		// read-only view of vols, without copy: a term structure or a skew of a surface (contiguous), or a cell of
+		// all the surfaces of a universe (strided): element i is data()[i * stride()]
+		// valid until the grids of the surface change (let_strikes, let_maturities) or the universe is run again
+		class vol_view
+		{
+		public:
+			
+			// forward iterator on the elements (read-only)
+			class iterator
+			{
+			public:
+				
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = double;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const double*;
+				using reference = const double&;
+				
+				iterator();
+				iterator(const double* data, std::size_t stride, std::size_t i);
+				reference operator*() const;
+				pointer operator->() const;
+				iterator& operator++();
+				iterator operator++(int);
+				bool operator==(const iterator& other) const;
+				bool operator!=(const iterator& other) const;
+				
+			private:
+				
+				const double* p_data;
+				std::size_t m_stride;
+				std::size_t m_index;
+			};
+			
+			// constructors
+			vol_view();
+			vol_view(const double* data, std::size_t size, std::size_t stride = 1);
+			
+			// access
+			std::size_t size() const;
+			bool empty() const;
+			const double* data() const; // first element
+			std::size_t stride() const;
+			iterator begin() const;
+			iterator end() const;
+			double operator[](std::size_t i) const;
+			
+			std::vector<double> to_vector() const; // copy
+			
+			
+		private:
+			
+			// data members
+			const double* p_data;
+			std::size_t m_size;
+			std::size_t m_stride;
+		};
+		
 		// class of the volatility surface
 		class vol_surface
 		{
@@ -47,9 +164,19 @@ namespace project
 
 			
 			// access - volatilities
-			double get_vol(double strike, double maturity) const;
+			double get_vol(double strike, double maturity) const; // cell of the grid
+			double get_vol(double strike, double maturity, interpolation method) const; // any point
+			// n points (strikes[k], maturities[k]), in the units of the grid (% of the spot, months)
+			void get_vols(const double* strikes, const double* maturities, std::size_t n, double* vols,
+						  interpolation method = interpolation::cubic) const;
 			std::vector<double> get_strike(double strike) const; // term structure
 			std::vector<double> get_maturity(double maturity) const; // skew
+			vol_view get_term_structure(double strike) const; // same without copy (empty if not in the grid)
+			vol_view get_skew(double maturity) const;
+			
+			// access - diagnostics (same order as the vols, see BS::hedged_ptf::get_metrics for the totals)
+			const std::vector<cell_diagnostics>& get_diagnostics() const;
+			cell_diagnostics get_diagnostics(double strike, double maturity) const;
 			
 			
 			// printing - general
@@ -65,7 +192,21 @@ namespace project
 			
 			
 			// modify
-			void load_vol_surface(bool robust_pnl = false); // loops with ptf.get_implied_vol()
+			// computes every cell with the reentrant ptf.get_implied_vol() on a work-stealing thread pool
+			// the ptf is not modified: its range and strike stay as they are
+			void load_vol_surface(bool robust_pnl = false, std::size_t nb_threads = 0); // 0: one thread per core
+			void load_vol_surface(MT::thread_pool& pool, bool robust_pnl = false); // on an existing pool
+			
+			// same with one task per maturity: the strikes of a maturity are solved together by
+			// ptf.solve_implied_vols(), which reads the range once per dichotomy step for all of them
+			void load_vol_surface_fused(bool robust_pnl = false, std::size_t nb_threads = 0);
+			void load_vol_surface_fused(MT::thread_pool& pool, bool robust_pnl = false);
+			
+			// recomputes only the maturities whose range changed since the last computation (eg. after
+			// ptf.append()), each cell warm-started from its previous vol (see hedged_ptf::solve_implied_vol_from)
+			// all the maturities are recomputed after a change of the rate, day count or accuracy of the ptf
+			void refresh_vol_surface(std::size_t nb_threads = 0);
+			void refresh_vol_surface(MT::thread_pool& pool);
 			
 			void let_strikes(std::vector<double> strikes = {50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150});
 			void let_maturities(std::vector<double> maturities = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12});
@@ -75,6 +216,9 @@ namespace project
 			
 			// export
 			void export_to_csv(std::string path = "../") const; // default path is outside of build
+			void export_diagnostics_to_csv(std::string path = "../") const; // one line per cell
+			void export_to_binary(std::string path = "../") const; // one surface, with its grid and its metadata
+			void export_to_binary(surface_writer& writer) const; // appended to a file of surfaces
 			
 			
 			
@@ -90,13 +234,59 @@ namespace project
 			// first dimention are the strikes, second are the maturities
 			std::vector<double> m_vols;
 			
+			// same surface stored by strike (the maturities of a strike are contiguous, for the term structures)
+			// written with m_vols by store_cell
+			std::vector<double> m_vols_by_strike;
+			
+			// diagnostics of each cell (same dimensions as m_vols)
+			std::vector<cell_diagnostics> m_diagnostics;
+			
+			// range of each maturity at the last computation (end is 0 if not computed), with the parameters of
+			// the ptf it was computed with (a new rate, day count or accuracy changes the vols of the same range)
+			std::vector<std::size_t> m_starts;
+			std::vector<std::size_t> m_ends;
+			std::vector<double> m_rates;
+			std::vector<TS::day_count> m_day_counts;
+			std::vector<BS::accuracy> m_accuracies;
+			
 			// hedged_ptf class from which we get the implied vols
 			BS::hedged_ptf *p_ptf;
 			
+			// interpolation: sorted grids (positions in m_strikes and m_maturities in m_strike_order and
+			// m_maturity_order) and, for each sorted maturity, the vols, the slopes and the cubic
+			// coefficients (a, b, c, d in powers of strike - node) of each strike interval
+			grid_locator m_strike_grid;
+			grid_locator m_maturity_grid;
+			std::vector<std::size_t> m_strike_order;
+			std::vector<std::size_t> m_maturity_order;
+			std::vector<double> m_grid_vols;
+			std::vector<double> m_slopes;
+			std::vector<double> m_cubic;
+			
 			// private methods for getting indices
 			std::size_t index_strike(double strike) const;
 			std::size_t index_maturity(double maturity) const;
 			
+			// sorted grids (after a change of strikes or maturities) and interpolation coefficients (after
+			// a computation of the vols)
+			void update_grids();
+			void update_interpolation();
+			
+			// maturities from the longest to the shortest (for the balance of the thread pool)
+			std::vector<std::size_t> maturities_order() const;
+			
+			// forgets the ranges (and the diagnostics) of the last computation
+			void reset_ranges();
+			
+			// range of a maturity with the current parameters of the ptf, and whether its cells are up to date
+			void store_range(std::size_t maturity, std::size_t start, std::size_t end);
+			bool is_current(std::size_t maturity, std::size_t start, std::size_t end) const;
+			// leaves a maturity uncomputed if its range is empty (a gap of more than the maturity at the end of the data)
+			bool skip_range(std::size_t maturity, std::size_t start, std::size_t end);
+			
+			// writes the vol and the diagnostics of a cell (the vol is 0 if the solver did not converge)
+			void store_cell(std::size_t index, BS::solver_result result, std::size_t start, std::size_t end, double seconds);
+			
 			
 		};
 		